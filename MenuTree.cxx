@@ -116,6 +116,9 @@ MenuTree* CreateMenuTree()
 	snode = menuTree->InsertMenuItem("PPM User Monitor", "/Options", NULL);
 	menuTree->SetNodeHelpText(snode, "Run program that lets you see which ppm users\nand supercycle tables are active and have been\nactive recently.");
 
+	snode = menuTree->InsertMenuItem("Performance Monitor", "/Options", NULL);
+	menuTree->SetNodeHelpText(snode, "Brings up a window showing, for each server, the requests pet\nitself sends (CLD window checks and -ppm lookups) which are queued,\nin flight, completed, failed and timed out, and their mean reply time.");
+
 	snode = menuTree->InsertMenuItem("----", "/Options", NULL);
 	menuTree->SetNodeType(snode, MenuSeparatorType);
 
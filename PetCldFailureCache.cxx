@@ -0,0 +1,77 @@
+#include <string.h>
+#include <sys/time.h>
+#include <agsPage/genCldLib.hxx>		// for the DEVICE_* failure codes
+#include "PetCldFailureCache.hxx"
+
+PetCldFailureCache* GlobalCldFailureCache()
+{
+  static PetCldFailureCache cache;
+  return &cache;
+}
+
+////////////// PetCldFailureCache Class Methods ////////////////////////
+PetCldFailureCache::PetCldFailureCache()
+{
+  _failureMsec = PET_CLD_FAILURE_MSEC;
+}
+
+double PetCldFailureCache::NowMsec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+const PetCldFailure* PetCldFailureCache::Find(const char* cldName)
+{
+  if (cldName == NULL)
+    return NULL;
+  std::map<std::string, PetCldFailure>::iterator it = _failures.find(cldName);
+  if (it == _failures.end())
+    return NULL;
+  if (NowMsec() >= it->second.expires) {
+    _failures.erase(it);
+    return NULL;
+  }
+  return &it->second;
+}
+
+void PetCldFailureCache::Remember(const char* cldName, int failure)
+{
+  PetCldFailure& entry = _failures[cldName];
+  entry.failure = failure;
+  entry.expires = NowMsec() + _failureMsec;
+}
+
+void PetCldFailureCache::Failed(const char* cldName, int failure)
+{
+  if (cldName == NULL)
+    return;
+  if (IsPermanentFailure(failure))
+    Remember(cldName, failure);
+  else
+    Remove(cldName);
+}
+
+void PetCldFailureCache::NoDataToCollect(const char* cldName)
+{
+  if (cldName != NULL)
+    Remember(cldName, 0);
+}
+
+void PetCldFailureCache::Remove(const char* cldName)
+{
+  if (cldName != NULL)
+    _failures.erase(cldName);
+}
+
+void PetCldFailureCache::Invalidate()
+{
+  _failures.clear();
+}
+
+bool PetCldFailureCache::IsPermanentFailure(int failure)
+{
+  return failure == DEVICE_BAD_NAME || failure == DEVICE_BAD_REPORTFORMAT ||
+         failure == DEVICE_UNPACKERROR;
+}
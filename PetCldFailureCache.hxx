@@ -0,0 +1,63 @@
+#ifndef _PET_CLD_FAILURE_CACHE_HXX
+#define _PET_CLD_FAILURE_CACHE_HXX
+
+#include <map>
+#include <string>
+
+// how long a failed CLD is failed fast before it is tried again
+#define PET_CLD_FAILURE_MSEC	60000
+
+// PetCldFailure is why a window could not be created for a CLD
+struct PetCldFailure
+{
+  int    failure;	// the ReasonNoCreate() of the failed creation, 0 if it had no data to collect
+  double expires;	// msec when the failure is forgotten
+};
+
+// PetCldFailureCache remembers, for all CLD windows of a pet process whatever
+// their PPM user, the CLDs for which window creation failed for a reason that
+// lies in the CLD itself (bad name, bad report format, no data to collect).
+// Such a CLD is failed fast for a while instead of repeating the database
+// lookups and the wait for its report, and then tried again.  Nothing is
+// remembered about CLDs whose windows were created.
+class PetCldFailureCache
+{
+public:
+  PetCldFailureCache();
+
+  // the remembered failure of a CLD - NULL if there is none, or if it has
+  // expired
+  const PetCldFailure* Find(const char* cldName);
+
+  // remember a failed creation - transient failures like a report timeout
+  // are not remembered, and make an earlier failure be forgotten
+  void Failed(const char* cldName, int failure);
+
+  // remember a window which was created but had no data to collect
+  void NoDataToCollect(const char* cldName);
+
+  // how long failures are remembered
+  void SetFailureMsec(unsigned long msec) { _failureMsec = msec; }
+
+  // forget one CLD (its window was created) or every CLD (after a DDF reload)
+  void Remove(const char* cldName);
+  void Invalidate();
+
+  // true if the failure code means the CLD can not be displayed until the DDF
+  // changes, as opposed to a transient problem like a report timeout
+  static bool IsPermanentFailure(int failure);
+
+  // msec of the wall clock
+  static double NowMsec();
+
+private:
+  std::map<std::string, PetCldFailure> _failures;
+  unsigned long                        _failureMsec;
+
+  void Remember(const char* cldName, int failure);
+};
+
+// the process wide CLD failure cache
+PetCldFailureCache* GlobalCldFailureCache();
+
+#endif
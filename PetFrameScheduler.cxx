@@ -0,0 +1,124 @@
+#include "PetFrameScheduler.hxx"
+
+static PetFrameScheduler* globalFrameScheduler = NULL;
+
+PetFrameScheduler* GlobalFrameScheduler()
+{
+  return globalFrameScheduler;
+}
+
+void SetGlobalFrameScheduler(PetFrameScheduler* scheduler)
+{
+  globalFrameScheduler = scheduler;
+}
+
+////////////// PetFrameScheduler Class Methods ////////////////////////
+PetFrameScheduler::PetFrameScheduler(PetTimerWheel* wheel)
+{
+  _wheel = wheel;
+  _numMarks = 0;
+  _numFrames = 0;
+}
+
+PetFrameScheduler::~PetFrameScheduler()
+{
+  while (!_pages.empty())
+    Unregister(_pages.begin()->first);
+}
+
+void PetFrameScheduler::Register(PetFrameClient* client, unsigned long frameMsec)
+{
+  if (client == NULL || _pages.find(client) != _pages.end())
+    return;
+  Page* page = new Page;
+  page->client = client;
+  page->frameMsec = (frameMsec > 0) ? frameMsec : PET_DEFAULT_FRAME_MSEC;
+  page->timerId = 0L;
+  _pages[client] = page;
+}
+
+void PetFrameScheduler::Unregister(PetFrameClient* client)
+{
+  std::map<PetFrameClient*, Page*>::iterator it = _pages.find(client);
+  if (it == _pages.end())
+    return;
+  Page* page = it->second;
+  if (page->timerId > 0L) {
+    _wheel->Cancel(page->timerId);
+    _timers.erase(page->timerId);
+  }
+  _pages.erase(it);
+  delete page;
+}
+
+void PetFrameScheduler::SetFrameMsec(PetFrameClient* client, unsigned long frameMsec)
+{
+  std::map<PetFrameClient*, Page*>::iterator it = _pages.find(client);
+  if (it != _pages.end())
+    it->second->frameMsec = (frameMsec > 0) ? frameMsec : PET_DEFAULT_FRAME_MSEC;
+}
+
+void PetFrameScheduler::MarkDirty(PetFrameClient* client, unsigned long cell)
+{
+  std::map<PetFrameClient*, Page*>::iterator it = _pages.find(client);
+  if (it == _pages.end())
+    return;
+  Page* page = it->second;
+  _numMarks++;
+
+  if (cell >= page->isDirty.size())
+    page->isDirty.resize(cell + 1, false);
+  if (!page->isDirty[cell]) {
+    page->isDirty[cell] = true;
+    page->dirty.push_back(cell);
+  }
+
+  // the first mark of a frame starts the frame
+  if (page->timerId == 0L) {
+    page->timerId = _wheel->Arm(this, page->frameMsec);
+    if (page->timerId == 0L)
+      FlushPage(page);  // no timer - paint right away rather than never
+    else
+      _timers[page->timerId] = page;
+  }
+}
+
+void PetFrameScheduler::Flush(PetFrameClient* client)
+{
+  std::map<PetFrameClient*, Page*>::iterator it = _pages.find(client);
+  if (it == _pages.end())
+    return;
+  Page* page = it->second;
+  if (page->timerId > 0L) {
+    _wheel->Cancel(page->timerId);
+    _timers.erase(page->timerId);
+    page->timerId = 0L;
+  }
+  FlushPage(page);
+}
+
+void PetFrameScheduler::TimerExpired(unsigned long timerId)
+{
+  std::map<unsigned long, Page*>::iterator it = _timers.find(timerId);
+  if (it == _timers.end())
+    return;
+  Page* page = it->second;
+  _timers.erase(it);
+  page->timerId = 0L;
+  FlushPage(page);
+}
+
+void PetFrameScheduler::FlushPage(Page* page)
+{
+  if (page->dirty.empty())
+    return;
+
+  // take the dirty list first - the client may mark cells (or unregister)
+  // while it repaints, those go into the next frame
+  std::vector<unsigned long> dirty;
+  dirty.swap(page->dirty);
+  for (unsigned i=0; i<dirty.size(); i++)
+    page->isDirty[dirty[i]] = false;
+  _numFrames++;
+  page->client->FlushFrame(dirty);
+}
@@ -0,0 +1,74 @@
+#ifndef _PET_FRAME_SCHEDULER_HXX
+#define _PET_FRAME_SCHEDULER_HXX
+
+#include <map>
+#include <vector>
+#include "PetTimerWheel.hxx"
+
+// the default frame rate - 20 frames per second
+#define PET_DEFAULT_FRAME_MSEC	50
+
+// PetFrameClient is anything that repaints in frames, like the message area of
+// the main window.  Cells are identified by small numbers, e.g. their row.
+// The cells of device pages are painted by the page libraries themselves.
+class PetFrameClient
+{
+public:
+  virtual ~PetFrameClient() {}
+  // repaint the cells which changed since the last frame - each cell is
+  // listed once, in the order it was first marked
+  virtual void FlushFrame(const std::vector<unsigned long>& dirtyCells) = 0;
+};
+
+// PetFrameScheduler coalesces updates into frames.  An update only marks its
+// cell dirty; the first mark of a frame arms a timer on the timer wheel, and
+// when it expires the client repaints all of the dirty cells at once.  Cells
+// updated several times within a frame are repainted once, and an idle client
+// costs no timer at all.
+class PetFrameScheduler : public PetTimerClient
+{
+public:
+  PetFrameScheduler(PetTimerWheel* wheel);
+  ~PetFrameScheduler();
+
+  // add a client with its frame period (0 for the default)
+  void Register(PetFrameClient* client, unsigned long frameMsec = 0);
+  void Unregister(PetFrameClient* client);
+  void SetFrameMsec(PetFrameClient* client, unsigned long frameMsec);
+
+  // mark a cell for repainting with the next frame
+  void MarkDirty(PetFrameClient* client, unsigned long cell);
+
+  // repaint the dirty cells of a client right away, e.g. before a print
+  void Flush(PetFrameClient* client);
+
+  // number of marks and of frames flushed so far - marks / frames is how many
+  // updates each repaint absorbed
+  unsigned long long NumMarks() const { return _numMarks; }
+  unsigned long long NumFrames() const { return _numFrames; }
+
+  void TimerExpired(unsigned long timerId);
+
+private:
+  struct Page {
+    PetFrameClient*             client;
+    unsigned long               frameMsec;
+    unsigned long               timerId;
+    std::vector<unsigned long>  dirty;
+    std::vector<bool>           isDirty;	// indexed by cell
+  };
+
+  PetTimerWheel*                        _wheel;
+  std::map<PetFrameClient*, Page*>      _pages;
+  std::map<unsigned long, Page*>        _timers;
+  unsigned long long                    _numMarks;
+  unsigned long long                    _numFrames;
+
+  void FlushPage(Page* page);
+};
+
+// the process wide frame scheduler
+PetFrameScheduler* GlobalFrameScheduler();
+void SetGlobalFrameScheduler(PetFrameScheduler* scheduler);
+
+#endif
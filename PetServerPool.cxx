@@ -0,0 +1,591 @@
+#include <sys/time.h>
+#include <cdevDevice.h>
+#include <cdevCallback.h>
+#include <cdevRequestObject.h>
+#include <cdevErrCode.h>
+#include "PetServerPool.hxx"
+
+// the cdev device which answers name queries - served by the CNS (see cdevCnsInit())
+#define PET_DIRECTORY_DEVICE	"cdevDirectory"
+
+// a CNS which does not answer, and the probe of a down server, back off
+// from the first to the last delay
+#define PET_BACKOFF_FIRST_MSEC	1000
+#define PET_BACKOFF_LAST_MSEC	60000
+
+static PetServerPool* globalServerPool = NULL;
+
+PetServerPool* GlobalServerPool()
+{
+  return globalServerPool;
+}
+
+void SetGlobalServerPool(PetServerPool* pool)
+{
+  globalServerPool = pool;
+}
+
+static double NowMsec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// true for a request which only reads, and may be sent again as a probe
+static bool IsGet(const std::string& message)
+{
+  return message.compare(0, 4, "get ") == 0;
+}
+
+static unsigned long NextBackoff(unsigned long msec)
+{
+  return (msec * 2 < PET_BACKOFF_LAST_MSEC) ? msec * 2 : PET_BACKOFF_LAST_MSEC;
+}
+
+////////////// PetServerPool Class Methods ////////////////////////
+PetServerPool::PetServerPool(PetTimerWheel* wheel, int window)
+{
+  _wheel = wheel;
+  _window = (window > 0) ? window : 1;
+  _threshold = 3;
+  _timeoutMsec = 5000;
+  _nextId = 1;
+  _cnsRetryTime = 0.0;
+  _cnsBackoffMsec = PET_BACKOFF_FIRST_MSEC;
+}
+
+PetServerPool::~PetServerPool()
+{
+  std::map<unsigned long, Request*>::iterator rit;
+  for (rit = _timeouts.begin(); rit != _timeouts.end(); ++rit)
+    _wheel->Cancel(rit->first);
+  std::map<unsigned long, Server*>::iterator pit;
+  for (pit = _probes.begin(); pit != _probes.end(); ++pit)
+    _wheel->Cancel(pit->first);
+  std::map<unsigned long, Lookup*>::iterator lit;
+  for (lit = _lookups.begin(); lit != _lookups.end(); ++lit) {
+    _wheel->Cancel(lit->first);
+    lit->second->pool = NULL;  // freed by its reply
+  }
+  std::map<std::string, std::vector<Request*> >::iterator wit;
+  for (wit = _resolving.begin(); wit != _resolving.end(); ++wit)
+    for (unsigned i=0; i<wit->second.size(); i++)
+      delete wit->second[i];
+
+  std::map<std::string, Server*>::iterator it;
+  for (it = _servers.begin(); it != _servers.end(); ++it) {
+    Server* server = it->second;
+    Request* request;
+    while ((request = NextRequest(server)) != NULL)
+      delete request;
+    delete server;
+  }
+  // replies may still come for the sent requests - they are dropped then
+  for (rit = _inFlight.begin(); rit != _inFlight.end(); ++rit)
+    Release(rit->second);
+}
+
+PetServerPool::Server* PetServerPool::GetServer(const std::string& name)
+{
+  Server*& server = _servers[name];
+  if (server == NULL) {
+    server = new Server;
+    server->name = name;
+    server->stats.queued = 0;
+    server->stats.inFlight = 0;
+    server->stats.completed = 0;
+    server->stats.failed = 0;
+    server->stats.timeouts = 0;
+    server->stats.failedFast = 0;
+    server->stats.totalLatencyMsec = 0.0;
+    server->stats.maxLatencyMsec = 0.0;
+    server->stats.down = false;
+    server->timeoutsInRow = 0;
+    server->backoffMsec = PET_BACKOFF_FIRST_MSEC;
+    server->probeTimerId = 0L;
+    server->probing = false;
+    server->halfOpen = false;
+  }
+  return server;
+}
+
+std::string PetServerPool::QueueName(const std::string& serverName, const std::string& device)
+{
+  if (!serverName.empty() || device.empty())
+    return serverName;
+  return "(" + device + ")";
+}
+
+unsigned long PetServerPool::Submit(const char* serverName, const char* device,
+                                    const char* message, cdevData& data,
+                                    PetServerRequester* requester, const void* owner,
+                                    bool interactive)
+{
+  Request* request = new Request;
+  request->pool = this;
+  request->server = NULL;
+  request->id = _nextId++;
+  request->device = (device != NULL) ? device : "";
+  request->message = (message != NULL) ? message : "";
+  request->data = data;
+  request->requester = requester;
+  request->owner = owner;
+  request->submitted = NowMsec();
+  request->timerId = 0L;
+  request->reply = NULL;
+  request->probe = false;
+  request->interactive = interactive;
+  unsigned long id = request->id;
+
+  if (serverName != NULL || device == NULL) {
+    Enqueue(request, (serverName != NULL) ? serverName : "");
+    return id;
+  }
+  std::map<std::string, std::string>::iterator it = _deviceServers.find(device);
+  if (it != _deviceServers.end() || NowMsec() < _cnsRetryTime) {
+    // known, or the CNS is down and not asked again before its backoff is over
+    Enqueue(request, (it != _deviceServers.end()) ? it->second : "");
+    return id;
+  }
+
+  // wait for the server to be looked up - one query per device
+  std::vector<Request*>& waiting = _resolving[device];
+  waiting.push_back(request);
+  if (waiting.size() == 1)
+    Resolve(device);
+  return id;
+}
+
+void PetServerPool::Enqueue(Request* request, const std::string& serverName)
+{
+  Server* server = GetServer(QueueName(serverName, request->device));
+  request->server = server;
+
+  if (server->stats.down) {
+    FailFast(request);
+    return;
+  }
+
+  if (request->interactive)
+    server->interactive.push_back(request);
+  else {
+    Queue& queue = server->byOwner[request->owner];
+    if (queue.empty())
+      server->rotation.push_back(request->owner);
+    queue.push_back(request);
+  }
+  server->stats.queued++;
+
+  Dispatch(server);
+}
+
+void PetServerPool::Resolve(const std::string& device)
+{
+  Lookup* lookup = new Lookup;
+  lookup->pool = this;
+  lookup->device = device;
+  lookup->callback = new cdevCallback(LookupCallback, lookup);
+  lookup->timerId = 0L;
+  lookup->abandoned = false;
+  lookup->in.insert("device", (char*) device.c_str());
+
+  cdevDevice* directory = cdevDevice::attachPtr(PET_DIRECTORY_DEVICE);
+  if (directory == NULL ||
+      directory->sendCallback("query", lookup->in, *lookup->callback) != CDEV_SUCCESS) {
+    Resolved(lookup, NULL);
+    delete lookup->callback;
+    delete lookup;
+    return;
+  }
+  // the callback may have come (and freed the lookup) already
+  if (_resolving.find(device) != _resolving.end()) {
+    lookup->timerId = _wheel->Arm(this, _timeoutMsec);
+    if (lookup->timerId > 0L)
+      _lookups[lookup->timerId] = lookup;
+  }
+}
+
+void PetServerPool::LookupCallback(int status, void* arg, cdevRequestObject&, cdevData& data)
+{
+  Lookup* lookup = (Lookup*) arg;
+  if (lookup->pool == NULL || lookup->abandoned) {
+    // the pool is gone or the lookup timed out already
+    delete lookup->callback;
+    delete lookup;
+    return;
+  }
+  char server[256];
+  if (status == CDEV_SUCCESS && data.get("server", server, sizeof(server)) == CDEV_SUCCESS)
+    lookup->pool->Resolved(lookup, server);
+  else if (status == CDEV_SUCCESS)
+    lookup->pool->Resolved(lookup, "");  // the CNS does not know the device
+  else
+    lookup->pool->Resolved(lookup, NULL);
+  delete lookup->callback;
+  delete lookup;
+}
+
+void PetServerPool::Resolved(Lookup* lookup, const char* serverName)
+{
+  if (lookup->timerId > 0L) {
+    _wheel->Cancel(lookup->timerId);
+    _lookups.erase(lookup->timerId);
+    lookup->timerId = 0L;
+  }
+  if (serverName != NULL) {
+    _cnsBackoffMsec = PET_BACKOFF_FIRST_MSEC;
+    _deviceServers[lookup->device] = serverName;
+  }
+  else {
+    // the CNS did not answer - do not ask it again before the backoff is over
+    _cnsRetryTime = NowMsec() + _cnsBackoffMsec;
+    _cnsBackoffMsec = NextBackoff(_cnsBackoffMsec);
+  }
+
+  std::vector<Request*> waiting;
+  std::map<std::string, std::vector<Request*> >::iterator it = _resolving.find(lookup->device);
+  if (it != _resolving.end()) {
+    waiting.swap(it->second);
+    _resolving.erase(it);
+  }
+  std::string server = (serverName != NULL) ? serverName : "";
+  for (unsigned i=0; i<waiting.size(); i++)
+    Enqueue(waiting[i], server);
+}
+
+void PetServerPool::CancelOwner(const void* owner)
+{
+  std::map<std::string, Server*>::iterator it;
+  for (it = _servers.begin(); it != _servers.end(); ++it) {
+    Server* server = it->second;
+    std::map<const void*, Queue>::iterator qit = server->byOwner.find(owner);
+    if (qit != server->byOwner.end()) {
+      for (unsigned i=0; i<qit->second.size(); i++)
+        delete qit->second[i];
+      server->stats.queued -= qit->second.size();
+      server->byOwner.erase(qit);
+      server->rotation.remove(owner);
+    }
+    for (Queue::iterator i = server->interactive.begin(); i != server->interactive.end(); ) {
+      if ((*i)->owner == owner) {
+        delete *i;
+        i = server->interactive.erase(i);
+        server->stats.queued--;
+      }
+      else
+        ++i;
+    }
+  }
+
+  std::map<std::string, std::vector<Request*> >::iterator wit;
+  for (wit = _resolving.begin(); wit != _resolving.end(); ++wit) {
+    std::vector<Request*>& waiting = wit->second;
+    for (unsigned i=0; i<waiting.size(); )
+      if (waiting[i]->owner == owner) {
+        delete waiting[i];
+        waiting.erase(waiting.begin() + i);
+      }
+      else
+        i++;
+  }
+
+  std::map<unsigned long, Request*>::iterator rit;
+  for (rit = _inFlight.begin(); rit != _inFlight.end(); ++rit)
+    if (rit->second->owner == owner)
+      rit->second->requester = NULL;
+}
+
+void PetServerPool::SetWindow(int window)
+{
+  _window = (window > 0) ? window : 1;
+  std::map<std::string, Server*>::iterator it;
+  for (it = _servers.begin(); it != _servers.end(); ++it)
+    Dispatch(it->second);
+}
+
+bool PetServerPool::GetStats(const char* serverName, PetServerStats& stats) const
+{
+  std::map<std::string, Server*>::const_iterator it = _servers.find(serverName ? serverName : "");
+  if (it == _servers.end())
+    return false;
+  stats = it->second->stats;
+  return true;
+}
+
+void PetServerPool::GetServers(std::vector<std::string>& servers) const
+{
+  servers.clear();
+  std::map<std::string, Server*>::const_iterator it;
+  for (it = _servers.begin(); it != _servers.end(); ++it)
+    servers.push_back(it->first);
+}
+
+PetServerPool::Request* PetServerPool::NextRequest(Server* server)
+{
+  Request* request = NULL;
+  if (!server->interactive.empty()) {
+    request = server->interactive.front();
+    server->interactive.pop_front();
+  }
+  else if (!server->rotation.empty()) {
+    // take one request of the owner at the front and send it to the back
+    const void* owner = server->rotation.front();
+    server->rotation.pop_front();
+    Queue& queue = server->byOwner[owner];
+    request = queue.front();
+    queue.pop_front();
+    if (queue.empty())
+      server->byOwner.erase(owner);
+    else
+      server->rotation.push_back(owner);
+  }
+  if (request != NULL)
+    server->stats.queued--;
+  return request;
+}
+
+void PetServerPool::Dispatch(Server* server)
+{
+  if (server->stats.down) {
+    Request* request;
+    while ((request = NextRequest(server)) != NULL)
+      FailFast(request);
+    return;
+  }
+
+  while (server->stats.inFlight < (unsigned long) _window && !server->stats.down) {
+    Request* request = NextRequest(server);
+    if (request == NULL)
+      break;
+    server->stats.inFlight++;
+    unsigned long id = request->id;
+    _inFlight[id] = request;
+    if (Send(request) != 0) {
+      cdevData empty;
+      Complete(request, CDEV_ERROR, empty);
+    }
+    else if (_inFlight.find(id) != _inFlight.end()) {
+      // not answered right away - time it out
+      request->timerId = _wheel->Arm(this, _timeoutMsec);
+      if (request->timerId > 0L)
+        _timeouts[request->timerId] = request;
+    }
+  }
+}
+
+void PetServerPool::FailFast(Request* request)
+{
+  request->server->stats.failedFast++;
+  PetServerRequester* requester = request->requester;
+  unsigned long id = request->id;
+  delete request;
+  cdevData empty;
+  if (requester != NULL)
+    requester->RequestDone(id, PET_SERVER_DOWN, empty);
+}
+
+int PetServerPool::Send(Request* request)
+{
+  cdevDevice* device = cdevDevice::attachPtr((char*) request->device.c_str());
+  if (device == NULL)
+    return -1;
+
+  // cdev holds on to the callback until the reply comes
+  Reply* reply = new Reply;
+  reply->request = request;
+  reply->callback = new cdevCallback(ReplyCallback, reply);
+  request->reply = reply;
+  if (device->sendCallback((char*) request->message.c_str(), request->data, *reply->callback) != CDEV_SUCCESS) {
+    request->reply = NULL;
+    delete reply->callback;
+    delete reply;
+    return -1;
+  }
+  return 0;
+}
+
+void PetServerPool::ReplyCallback(int status, void* arg, cdevRequestObject&, cdevData& data)
+{
+  Reply* reply = (Reply*) arg;
+  Request* request = reply->request;
+  delete reply->callback;
+  delete reply;
+  // the request is gone if it timed out or the pool was deleted
+  if (request != NULL) {
+    request->reply = NULL;
+    request->pool->Complete(request, status, data);
+  }
+}
+
+void PetServerPool::Release(Request* request)
+{
+  if (request->reply != NULL)
+    request->reply->request = NULL;
+  delete request;
+}
+
+void PetServerPool::Complete(Request* request, int status, cdevData& result)
+{
+  Finish(request, status, result);
+}
+
+void PetServerPool::Finish(Request* request, int status, cdevData& result)
+{
+  Server* server = request->server;
+  _inFlight.erase(request->id);
+  if (request->timerId > 0L) {
+    _wheel->Cancel(request->timerId);
+    _timeouts.erase(request->timerId);
+  }
+
+  if (request->probe) {
+    server->probing = false;
+    Release(request);
+    if (status == CDEV_TIMEOUT)
+      Probe(server);  // schedules the next one
+    else
+      BringUp(server);  // any answer shows the server is there
+    return;
+  }
+
+  server->stats.inFlight--;
+  double latency = NowMsec() - request->submitted;
+  server->stats.completed++;
+  if (status != CDEV_SUCCESS)
+    server->stats.failed++;
+  server->stats.totalLatencyMsec += latency;
+  if (latency > server->stats.maxLatencyMsec)
+    server->stats.maxLatencyMsec = latency;
+
+  if (status == CDEV_TIMEOUT) {
+    server->stats.timeouts++;
+    if (IsGet(request->message)) {
+      server->probeDevice = request->device;
+      server->probeMessage = request->message;
+    }
+    if (++server->timeoutsInRow >= _threshold || server->halfOpen)
+      TakeDown(server);
+  }
+  else {
+    server->timeoutsInRow = 0;
+    server->halfOpen = false;
+    server->backoffMsec = PET_BACKOFF_FIRST_MSEC;
+  }
+
+  PetServerRequester* requester = request->requester;
+  unsigned long id = request->id;
+  Release(request);
+
+  // refill the window before the requester gets to queue more
+  Dispatch(server);
+  if (requester != NULL)
+    requester->RequestDone(id, status, result);
+}
+
+void PetServerPool::TimerExpired(unsigned long timerId)
+{
+  std::map<unsigned long, Request*>::iterator rit = _timeouts.find(timerId);
+  if (rit != _timeouts.end()) {
+    Request* request = rit->second;
+    _timeouts.erase(rit);
+    request->timerId = 0L;
+    cdevData empty;
+    Finish(request, CDEV_TIMEOUT, empty);
+    return;
+  }
+
+  std::map<unsigned long, Lookup*>::iterator lit = _lookups.find(timerId);
+  if (lit != _lookups.end()) {
+    Lookup* lookup = lit->second;
+    _lookups.erase(lit);
+    lookup->timerId = 0L;
+    Resolved(lookup, NULL);
+    lookup->abandoned = true;  // freed by its late reply
+    return;
+  }
+
+  std::map<unsigned long, Server*>::iterator pit = _probes.find(timerId);
+  if (pit != _probes.end()) {
+    Server* server = pit->second;
+    _probes.erase(pit);
+    server->probeTimerId = 0L;
+    if (!server->stats.down || server->probing)
+      return;
+
+    if (server->probeMessage.empty()) {
+      // nothing which may be sent again - let the requests through, the
+      // next timeout takes the server down again
+      server->halfOpen = true;
+      server->stats.down = false;
+      Dispatch(server);
+      return;
+    }
+
+    // resend the get which timed out last - a reply of any kind closes the breaker
+    Request* probe = new Request;
+    probe->pool = this;
+    probe->server = server;
+    probe->id = _nextId++;
+    probe->device = server->probeDevice;
+    probe->message = server->probeMessage;
+    probe->requester = NULL;
+    probe->owner = NULL;
+    probe->submitted = NowMsec();
+    probe->timerId = 0L;
+    probe->reply = NULL;
+    probe->probe = true;
+    server->probing = true;
+    unsigned long id = probe->id;
+    _inFlight[id] = probe;
+    if (Send(probe) != 0) {
+      cdevData empty;
+      Complete(probe, CDEV_TIMEOUT, empty);
+    }
+    else if (_inFlight.find(id) != _inFlight.end()) {
+      probe->timerId = _wheel->Arm(this, _timeoutMsec);
+      if (probe->timerId > 0L)
+        _timeouts[probe->timerId] = probe;
+    }
+  }
+}
+
+void PetServerPool::TakeDown(Server* server)
+{
+  if (server->stats.down)
+    return;
+  server->stats.down = true;
+  // a server which went down again right after being let through keeps
+  // backing off
+  if (!server->halfOpen)
+    server->backoffMsec = PET_BACKOFF_FIRST_MSEC;
+  server->halfOpen = false;
+  Probe(server);
+  Dispatch(server);  // fails the queued requests
+}
+
+void PetServerPool::BringUp(Server* server)
+{
+  if (server->probeTimerId > 0L) {
+    _wheel->Cancel(server->probeTimerId);
+    _probes.erase(server->probeTimerId);
+    server->probeTimerId = 0L;
+  }
+  server->timeoutsInRow = 0;
+  server->halfOpen = false;
+  server->backoffMsec = PET_BACKOFF_FIRST_MSEC;
+  if (!server->stats.down)
+    return;
+  server->stats.down = false;
+  Dispatch(server);
+}
+
+void PetServerPool::Probe(Server* server)
+{
+  if (server->probeTimerId > 0L)
+    return;
+  server->probeTimerId = _wheel->Arm(this, server->backoffMsec);
+  if (server->probeTimerId > 0L)
+    _probes[server->probeTimerId] = server;
+  server->backoffMsec = NextBackoff(server->backoffMsec);
+}
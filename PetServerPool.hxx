@@ -0,0 +1,187 @@
+#ifndef _PET_SERVER_POOL_HXX
+#define _PET_SERVER_POOL_HXX
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <cdevData.h>
+#include "PetTimerWheel.hxx"
+
+class cdevRequestObject;
+class cdevCallback;
+
+// the status of a request failed fast because its server is down
+#define PET_SERVER_DOWN		(-1000)
+
+// PetServerRequester gets the replies of requests made through a PetServerPool
+class PetServerRequester
+{
+public:
+  virtual ~PetServerRequester() {}
+  virtual void RequestDone(unsigned long requestId, int status, cdevData& result) = 0;
+};
+
+// the counters of one server
+struct PetServerStats
+{
+  unsigned long      queued;		// waiting for a slot in the window
+  unsigned long      inFlight;		// sent, no reply yet
+  unsigned long long completed;
+  unsigned long long failed;
+  unsigned long long timeouts;
+  unsigned long long failedFast;	// while the server was down
+  double             totalLatencyMsec;	// from submission to reply
+  double             maxLatencyMsec;
+  bool               down;
+
+  double MeanLatencyMsec() const
+    { return completed > 0 ? totalLatencyMsec / completed : 0.0; }
+};
+
+// PetServerPool funnels the requests pet makes to each server through one
+// queue per server.  At most a window of requests is outstanding to a server
+// at a time - the rest wait in the queue and go out as replies come back, so
+// a page with a thousand cells can not flood a server.  The queue is served
+// fairly: interactive requests go first, the others are taken round robin
+// from the owners which have some waiting.  A device whose server is not
+// known (the CNS does not know it or is not answering) gets a queue of its
+// own, named after the device in parentheses, so that it shares neither the
+// window nor the breaker with other such devices.
+//
+// Each server also has a circuit breaker.  After a number of timeouts in a
+// row the server is taken as down: its requests fail at once with
+// PET_SERVER_DOWN instead of each waiting out its own timeout.  After a
+// backoff, which grows exponentially, the last get which timed out is sent
+// again as a probe, and any answer brings the server back.  Sets are never
+// repeated - a server which only timed out on sets is let through again
+// after the backoff, and one more timeout takes it down again.
+class PetServerPool : public PetTimerClient
+{
+public:
+  PetServerPool(PetTimerWheel* wheel, int window = 8);
+  virtual ~PetServerPool();
+
+  // queue a request - server may be NULL to look it up in the CNS, which is
+  // done with a non-blocking query; the request waits for its answer
+  // returns the request id; a request which can not be sent at all is
+  // completed with an error before Submit() returns
+  unsigned long Submit(const char* server, const char* device, const char* message,
+                       cdevData& data, PetServerRequester* requester,
+                       const void* owner = NULL, bool interactive = false);
+
+  // forget the requests of an owner - queued ones are dropped, replies to
+  // sent ones are not passed on
+  void CancelOwner(const void* owner);
+
+  // the number of outstanding requests allowed per server
+  void SetWindow(int window);
+  int GetWindow() const { return _window; }
+
+  // how long a request may take, and how many timeouts in a row take a
+  // server down
+  void SetRequestTimeout(unsigned long msec) { _timeoutMsec = msec; }
+  void SetBreakerThreshold(int timeouts) { _threshold = (timeouts > 0) ? timeouts : 1; }
+
+  // the counters of a server - false if pet has not talked to it
+  bool GetStats(const char* server, PetServerStats& stats) const;
+  void GetServers(std::vector<std::string>& servers) const;
+
+  // request timeouts and probes
+  void TimerExpired(unsigned long timerId);
+
+protected:
+  struct Request;
+  typedef std::deque<Request*> Queue;
+  struct Server {
+    std::string                  name;
+    Queue                        interactive;
+    std::map<const void*, Queue> byOwner;
+    std::list<const void*>       rotation;	// owners with queued requests
+    PetServerStats               stats;
+    int                          timeoutsInRow;
+    unsigned long                backoffMsec;	// until the next probe
+    unsigned long                probeTimerId;
+    bool                         probing;	// a probe is out
+    bool                         halfOpen;	// let through after a backoff without a probe
+    std::string                  probeDevice;	// the get which timed out last
+    std::string                  probeMessage;
+  };
+  struct Reply;
+  struct Request {
+    PetServerPool*      pool;
+    Server*             server;
+    unsigned long       id;
+    std::string         device;
+    std::string         message;
+    cdevData            data;
+    PetServerRequester* requester;	// NULL once cancelled
+    const void*         owner;
+    double              submitted;	// msec
+    unsigned long       timerId;	// of the timeout
+    Reply*              reply;		// NULL until sent
+    bool                probe;
+    bool                interactive;
+  };
+  // where the reply to a sent request comes back - outlives a request which
+  // timed out, so that a late reply finds nothing to pass on
+  struct Reply {
+    Request*            request;	// NULL once the request is freed
+    cdevCallback*       callback;
+  };
+  // a CNS query for the server of a device
+  struct Lookup {
+    PetServerPool*      pool;		// NULL once the pool is gone
+    std::string         device;
+    cdevData            in;
+    cdevData            out;
+    cdevCallback*       callback;
+    unsigned long       timerId;
+    bool                abandoned;	// timed out, only a late reply may come
+  };
+
+  // send a request - returns non-zero if it could not be sent
+  // Complete() must be called with the reply
+  virtual int Send(Request* request);
+  void Complete(Request* request, int status, cdevData& result);
+  // free a request, leaving its reply to be freed when it comes
+  static void Release(Request* request);
+
+private:
+  PetTimerWheel*                  _wheel;
+  int                             _window;
+  int                             _threshold;
+  unsigned long                   _timeoutMsec;
+  unsigned long                   _nextId;
+  std::map<std::string, Server*>  _servers;
+  std::map<std::string, std::string> _deviceServers;	// CNS lookups
+  std::map<std::string, std::vector<Request*> > _resolving;	// waiting for a lookup
+  std::map<unsigned long, Lookup*> _lookups;		// by timer id
+  std::map<unsigned long, Request*> _inFlight;
+  std::map<unsigned long, Request*> _timeouts;		// by timer id
+  std::map<unsigned long, Server*> _probes;		// by timer id
+  double                          _cnsRetryTime;	// msec, while the CNS is down
+  unsigned long                   _cnsBackoffMsec;
+
+  Server* GetServer(const std::string& name);
+  static std::string QueueName(const std::string& serverName, const std::string& device);
+  void Enqueue(Request* request, const std::string& serverName);
+  void Resolve(const std::string& device);
+  void Resolved(Lookup* lookup, const char* serverName);
+  Request* NextRequest(Server* server);
+  void Dispatch(Server* server);
+  void Finish(Request* request, int status, cdevData& result);
+  void FailFast(Request* request);
+  void TakeDown(Server* server);
+  void BringUp(Server* server);
+  void Probe(Server* server);
+  static void ReplyCallback(int status, void* arg, cdevRequestObject& req, cdevData& data);
+  static void LookupCallback(int status, void* arg, cdevRequestObject& req, cdevData& data);
+};
+
+// the process wide server pool
+PetServerPool* GlobalServerPool();
+void SetGlobalServerPool(PetServerPool* pool);
+
+#endif
@@ -0,0 +1,268 @@
+#include <sys/time.h>
+#include "PetTimerWheel.hxx"
+
+static PetTimerWheel* globalTimerWheel = NULL;
+
+PetTimerWheel* GlobalTimerWheel()
+{
+  return globalTimerWheel;
+}
+
+void SetGlobalTimerWheel(PetTimerWheel* wheel)
+{
+  globalTimerWheel = wheel;
+}
+
+static unsigned long long WallClockMsec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (unsigned long long) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+////////////// PetTimerWheel Class Methods ////////////////////////
+PetTimerWheel::PetTimerWheel(unsigned long tickMsec)
+{
+  _tickMsec = (tickMsec > 0) ? tickMsec : 1;
+  _current = 0;
+  _nowTick = 0;
+  _numArmed = 0;
+  _startMsec = WallClockMsec();
+  for (int i=0; i<=NUM_BUCKETS; i++)
+    _heads[i] = NO_NODE;
+}
+
+PetTimerWheel::~PetTimerWheel()
+{
+}
+
+unsigned long long PetTimerWheel::Now() const
+{
+  return WallClockMsec() - _startMsec;
+}
+
+unsigned long PetTimerWheel::Arm(PetTimerClient* client, unsigned long msec, bool repeat)
+{
+  if (client == NULL)
+    return 0L;
+
+  // the wheel does not move while it is idle - catch up to the current time first
+  _nowTick = Now() / _tickMsec;
+  if (_numArmed == 0)
+    _current = _nowTick;
+
+  int index;
+  if (!_freeNodes.empty()) {
+    index = _freeNodes.back();
+    _freeNodes.pop_back();
+  } else {
+    if (_nodes.size() >= (1UL << INDEX_BITS) - 1)
+      return 0L;  // out of timer ids
+    Node node;
+    node.serial = 0;
+    _nodes.push_back(node);
+    index = _nodes.size() - 1;
+  }
+
+  // round up to whole ticks
+  unsigned long ticks = (msec + _tickMsec - 1) / _tickMsec;
+  if (ticks == 0)
+    ticks = 1;
+
+  Node& node = _nodes[index];
+  node.client = client;
+  node.expires = _nowTick + ticks;
+  node.period = repeat ? ticks : 0;
+  node.serial++;
+  node.bucket = NO_NODE;
+  Schedule(index);
+
+  if (++_numArmed == 1)
+    StartTicking();
+
+  return (node.serial << INDEX_BITS) | (unsigned long) (index + 1);
+}
+
+void PetTimerWheel::Cancel(unsigned long timerId)
+{
+  int index = NodeIndex(timerId);
+  if (index < 0)
+    return;
+  Unlink(index);
+  Release(index);
+}
+
+bool PetTimerWheel::IsArmed(unsigned long timerId) const
+{
+  return NodeIndex(timerId) >= 0;
+}
+
+void PetTimerWheel::Advance(unsigned long long nowMsec)
+{
+  unsigned long long target = nowMsec / _tickMsec;
+  _nowTick = target;
+  while (_current <= target && _numArmed > 0)
+    ProcessTick();
+  if (_numArmed == 0)
+    _current = target + 1;
+}
+
+int PetTimerWheel::NodeIndex(unsigned long timerId) const
+{
+  long index = (long) (timerId & ((1UL << INDEX_BITS) - 1)) - 1;
+  if (index < 0 || index >= (long) _nodes.size())
+    return -1;
+  const Node& node = _nodes[index];
+  if (node.bucket == NO_NODE || (timerId >> INDEX_BITS) != node.serial)
+    return -1;
+  return (int) index;
+}
+
+void PetTimerWheel::Link(int index, int bucket)
+{
+  Node& node = _nodes[index];
+  node.bucket = bucket;
+  node.prev = NO_NODE;
+  node.next = _heads[bucket];
+  if (node.next != NO_NODE)
+    _nodes[node.next].prev = index;
+  _heads[bucket] = index;
+}
+
+void PetTimerWheel::Unlink(int index)
+{
+  Node& node = _nodes[index];
+  if (node.bucket == NO_NODE)
+    return;
+  if (node.prev != NO_NODE)
+    _nodes[node.prev].next = node.next;
+  else
+    _heads[node.bucket] = node.next;
+  if (node.next != NO_NODE)
+    _nodes[node.next].prev = node.prev;
+  node.bucket = NO_NODE;
+}
+
+void PetTimerWheel::Schedule(int index)
+{
+  Node& node = _nodes[index];
+  unsigned long long expires = node.expires;
+  if (expires < _current)
+    expires = _current;
+
+  // pick the lowest level whose range still covers the delay
+  unsigned long long delta = expires - _current;
+  int level = 0;
+  while (level < LEVELS - 1 && delta >= (1ULL << (LEVEL_BITS * (level + 1))))
+    level++;
+  if (level == LEVELS - 1 && delta >= (1ULL << (LEVEL_BITS * LEVELS))) {
+    // beyond the range of the wheel - park it in the farthest slot, it is
+    // rescheduled from there when that slot cascades
+    expires = _current + (1ULL << (LEVEL_BITS * LEVELS)) - 1;
+  }
+  int slot = (int) ((expires >> (LEVEL_BITS * level)) & (SLOTS - 1));
+  Link(index, level * SLOTS + slot);
+}
+
+void PetTimerWheel::Cascade(int level)
+{
+  // move every timer of the current slot of this level down the wheel
+  int slot = (int) ((_current >> (LEVEL_BITS * level)) & (SLOTS - 1));
+  int bucket = level * SLOTS + slot;
+  int index = _heads[bucket];
+  _heads[bucket] = NO_NODE;
+  while (index != NO_NODE) {
+    int next = _nodes[index].next;
+    _nodes[index].bucket = NO_NODE;
+    Schedule(index);
+    index = next;
+  }
+}
+
+void PetTimerWheel::ProcessTick()
+{
+  // refill the lower levels each time the level below wraps around
+  for (int level = 1; level < LEVELS; level++) {
+    if ((_current & ((1ULL << (LEVEL_BITS * level)) - 1)) != 0)
+      break;
+    Cascade(level);
+  }
+
+  // move the expired timers to the pending list so that a client may arm or
+  // cancel any timer (including the expired ones) from its callback
+  int slot = (int) (_current & (SLOTS - 1));
+  int index = _heads[slot];
+  _heads[slot] = NO_NODE;
+  while (index != NO_NODE) {
+    int next = _nodes[index].next;
+    Link(index, PENDING_BUCKET);
+    index = next;
+  }
+
+  while ((index = _heads[PENDING_BUCKET]) != NO_NODE) {
+    Unlink(index);
+    Node& node = _nodes[index];
+    PetTimerClient* client = node.client;
+    unsigned long timerId = (node.serial << INDEX_BITS) | (unsigned long) (index + 1);
+    if (node.period > 0) {
+      // a repeating timer which fell behind (e.g. during a modal popup) fires
+      // once more and then resumes its period from now - it does not replay
+      // every missed period
+      node.expires = _nowTick + node.period;
+      Schedule(index);
+    }
+    else
+      Release(index);
+    client->TimerExpired(timerId);
+  }
+  _current++;
+}
+
+void PetTimerWheel::Release(int index)
+{
+  _nodes[index].bucket = NO_NODE;
+  _nodes[index].client = NULL;
+  _freeNodes.push_back(index);
+  if (--_numArmed == 0)
+    StopTicking();
+}
+
+////////////// PetAppTimerWheel Class Methods ////////////////////////
+PetAppTimerWheel::PetAppTimerWheel(UIApplication* app, unsigned long tickMsec)
+  : PetTimerWheel(tickMsec)
+{
+  _app = app;
+  _appTimerId = 0L;
+  _app->AddEventReceiver(this);
+}
+
+PetAppTimerWheel::~PetAppTimerWheel()
+{
+  StopTicking();
+  _app->RemoveEventReceiver(this);
+}
+
+void PetAppTimerWheel::HandleEvent(const UIObject* object, UIEvent event)
+{
+  if (object != _app || event != UITimer || _appTimerId == 0L ||
+      _app->GetTimerId() != _appTimerId)
+    return;
+
+  // application timers fire once - re-arm before dispatching so that a
+  // client which stops the last timer also stops the application timer
+  _appTimerId = _app->EnableTimerEvent(GetTickMsec());
+  Advance(Now());
+}
+
+void PetAppTimerWheel::StartTicking()
+{
+  if (_appTimerId == 0L)
+    _appTimerId = _app->EnableTimerEvent(GetTickMsec());
+}
+
+void PetAppTimerWheel::StopTicking()
+{
+  if (_appTimerId > 0L)
+    _app->DisableTimerEvent(_appTimerId);
+  _appTimerId = 0L;
+}
@@ -0,0 +1,112 @@
+#ifndef _PET_TIMER_WHEEL_HXX
+#define _PET_TIMER_WHEEL_HXX
+
+#include <vector>
+#include <UI/UIApplication.hxx>		// for UIApplication and UIEventReceiver classes
+
+// PetTimerWheel multiplexes any number of pet timers (page flashing, elog dumps,
+// staleness timeouts, ...) onto a single tick.  Timers are kept in a hierarchical
+// wheel of LEVELS x SLOTS buckets so that arming and cancelling are O(1) and each
+// tick only touches the timers that actually expire.  Expired timers are handed
+// straight to their owner through PetTimerClient::TimerExpired() instead of
+// being broadcast as UITimer events to every receiver of the application.
+
+class PetTimerClient
+{
+public:
+  virtual ~PetTimerClient() {}
+
+  // called when a timer armed by this client expires
+  virtual void TimerExpired(unsigned long timerId) = 0;
+};
+
+class PetTimerWheel
+{
+public:
+  PetTimerWheel(unsigned long tickMsec = 50);
+  virtual ~PetTimerWheel();
+
+  // arm a timer which expires after msec milliseconds - returns the timer id (> 0)
+  // a repeating timer keeps firing every msec milliseconds until it is cancelled
+  unsigned long Arm(PetTimerClient* client, unsigned long msec, bool repeat = false);
+
+  // cancel a timer - stale or already expired ids are ignored
+  void Cancel(unsigned long timerId);
+
+  // is the timer still waiting to expire
+  bool IsArmed(unsigned long timerId) const;
+
+  // number of armed timers
+  unsigned long NumArmed() const { return _numArmed; }
+
+  unsigned long GetTickMsec() const { return _tickMsec; }
+
+  // advance the wheel to the given time (msec since the wheel was created),
+  // dispatching every timer which expired on the way
+  void Advance(unsigned long long nowMsec);
+
+  // milliseconds elapsed since the wheel was created
+  unsigned long long Now() const;
+
+protected:
+  // the wheel needs (or no longer needs) to be ticked every GetTickMsec() msec
+  virtual void StartTicking() {}
+  virtual void StopTicking() {}
+
+private:
+  enum { LEVEL_BITS = 6, SLOTS = 1 << LEVEL_BITS, LEVELS = 4,
+         NUM_BUCKETS = LEVELS * SLOTS, PENDING_BUCKET = NUM_BUCKETS,
+         INDEX_BITS = 20, NO_NODE = -1 };
+
+  struct Node {
+    PetTimerClient*    client;
+    unsigned long long expires;	// in ticks
+    unsigned long      period;	// in ticks, 0 if not repeating
+    unsigned long      serial;	// bumped on every reuse so stale ids are detected
+    int                bucket;	// -1 if not armed
+    int                prev, next;
+  };
+
+  std::vector<Node>   _nodes;
+  std::vector<int>    _freeNodes;
+  int                 _heads[NUM_BUCKETS + 1];
+  unsigned long long  _current;	// next tick to be processed
+  unsigned long long  _nowTick;	// tick of the last Arm() or Advance() call
+  unsigned long       _tickMsec;
+  unsigned long       _numArmed;
+  unsigned long long  _startMsec;
+
+  int  NodeIndex(unsigned long timerId) const;
+  void Link(int index, int bucket);
+  void Unlink(int index);
+  void Schedule(int index);
+  void Cascade(int level);
+  void ProcessTick();
+  void Release(int index);
+};
+
+// PetAppTimerWheel drives a PetTimerWheel from one UIApplication timer which is
+// only running while at least one pet timer is armed
+class PetAppTimerWheel : public PetTimerWheel, public UIEventReceiver
+{
+public:
+  PetAppTimerWheel(UIApplication* app, unsigned long tickMsec = 50);
+  ~PetAppTimerWheel();
+
+  // service the application timer
+  void HandleEvent(const UIObject* object, UIEvent event);
+
+protected:
+  void StartTicking();
+  void StopTicking();
+
+private:
+  UIApplication* _app;
+  unsigned long  _appTimerId;
+};
+
+// the process wide timer wheel, NULL until one has been created
+PetTimerWheel* GlobalTimerWheel();
+void SetGlobalTimerWheel(PetTimerWheel* wheel);
+
+#endif
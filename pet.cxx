@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <sys/time.h>
 #include <signal.h>
 #include <UI/UIApplication.hxx>			// for UIApplication class
 #include <UI/UIArgumentList.hxx>		// for UIArgumentList class
@@ -25,6 +26,9 @@
 #include <MsgLog/MessageLogger.hxx>
 #include <utils/AppContext.hxx>
 #include "MenuTree.cxx"
+#include "PetCldFailureCache.hxx"
+#include "PetFrameScheduler.hxx"
+#include "PetServerPool.hxx"
 
 using namespace std;
 
@@ -43,6 +47,7 @@ static PetWindow*       activeAdoWin = NULL;
 static PetWindow*       singlePetWin = NULL;
 static PetEventReceiver petEventReceiver;
 static unsigned long    dumpElogAndExitTimerId = 0;
+static unsigned long    scaleBenchTimerId = 0;
 static const char* wname;
 
 static void clean_up(int st)
@@ -56,6 +61,67 @@ void errorHandler(int severity, char* text, cdevRequestObject* obj)
 {
 }
 
+// the PPM users which -ppm takes by name, and where their numbers are kept
+#define PET_PPM_SYSTEM		"injSpec.super"
+#define PET_PPM_WAIT_MSEC	15000
+
+static const char* ppmUserParams[][2] = {
+  { "BOOSTER_USER_FOR_NSRL", "boosterPpmUserForNsrlM" },
+  { "BOOSTER_USER_FOR_AGS",  "boosterPpmUserForAgsM" },
+  { "TANDEM_USER_FOR_NSRL",  "tandemPpmUserForNsrlM" },
+  { "TANDEM_USER_FOR_AGS",   "tandemPpmUserForAgsM" },
+  { "LINAC_USER_FOR_NSRL",   "linacPpmUserForNsrlM" },
+  { "LINAC_USER_FOR_AGS",    "linacPpmUserForAgsM" },
+  { "EBIS_USER_FOR_NSRL",    "ebisPpmUserForNsrlM" },
+  { "EBIS_USER_FOR_AGS",     "ebisPpmUserForAgsM" },
+  { "EBIS_USER_FOR_BOOSTER", "ebisPpmUserForBoosterM" },
+  { "AGS_USER_FOR_RHIC",     "agsPpmUserForRhicS" },
+  { NULL, NULL }
+};
+
+class PpmUserRequester : public PetServerRequester
+{
+public:
+  PpmUserRequester() : done(false), value(0) {}
+  void RequestDone(unsigned long, int status, cdevData& result)
+  {
+    char text[64];
+    if (status == CDEV_SUCCESS && result.get("value", text, sizeof(text)) == CDEV_SUCCESS)
+      value = atoi(text);
+    done = true;
+  }
+  bool done;
+  int  value;
+};
+
+// the PPM user of a -ppm argument - a number, or a name which is looked up
+// through the server pool; the main window does not exist yet, so this waits
+// for the reply
+static int ResolvePpmUser(const char* ppm)
+{
+  const char* param = NULL;
+  for (int i=0; ppmUserParams[i][0] != NULL; i++)
+    if (!strcmp(ppm, ppmUserParams[i][0]))
+      param = ppmUserParams[i][1];
+  if (param == NULL)
+    return atoi(ppm);
+
+  PpmUserRequester requester;
+  string message = string("get ") + param;
+  cdevData data;
+  GlobalServerPool()->Submit(NULL, PET_PPM_SYSTEM, message.c_str(), data, &requester, &requester, true);
+  // the pool times the request out, the deadline only guards the lookup
+  PetTimerWheel* wheel = GlobalTimerWheel();
+  unsigned long long deadline = wheel->Now() + PET_PPM_WAIT_MSEC;
+  while (!requester.done && wheel->Now() < deadline) {
+    cdevSystem::defaultSystem().pend(0.05);
+    wheel->Advance(wheel->Now());
+  }
+  if (!requester.done)
+    GlobalServerPool()->CancelOwner(&requester);
+  return requester.value;
+}
+
 int main(int argc, char *argv[])
 {
   //set up command line arguments
@@ -78,9 +144,16 @@ int main(int argc, char *argv[])
   argList.AddString("-elogEntryTitle", "", "", "a title to attach to this elog entry - use with -dumpToElog");
   argList.AddString("-elogAttachToTitle", "", "", "attach image to the entry with this title - use with -dumpToElog");
   argList.AddSwitch("-readOnly", "open pet in read-only mode.");
+  argList.AddString("-serverWindow", "", "", "the number of requests kept outstanding to each server (default 8).");
+  argList.AddString("-scaleBench", "", "", "time the main window with up to this many pages open, then exit (run under Xvfb for no display).");
+  argList.AddString("-scaleBenchOut", "", "", "the file -scaleBench writes its results to (default standard output).");
 
   // initialize the application
   application  = new UIApplication(argc, argv, &argList);
+  // all pet timers share one application timer
+  SetGlobalTimerWheel(new PetAppTimerWheel(application));
+  // bursts of messages to the main window are shown once per frame
+  SetGlobalFrameScheduler(new PetFrameScheduler(GlobalTimerWheel()));
   // set a fault handler to get tracebacks on program crashes
   set_app_history( (char*) application->Name() );
   set_default_fault_handler( (char*) application->Name() );
@@ -103,6 +176,12 @@ int main(int argc, char *argv[])
   defSystem.autoErrorOff();
   defSystem.setErrorHandler(errorHandler);
 
+  // requests to each server are queued and pipelined through a window
+  int serverWindow = 8;
+  if (argList.IsPresent("-serverWindow") && argList.Value("-serverWindow") > 0)
+    serverWindow = argList.Value("-serverWindow");
+  SetGlobalServerPool(new PetServerPool(GlobalTimerWheel(), serverWindow));
+
   // turn on storage of ADO/LD sets
   globalSetStorage()->storageOn();
 
@@ -114,66 +193,8 @@ int main(int argc, char *argv[])
       ioreq.setGlobalReadOnlyAccess();
   }
 
-  if (argList.IsPresent("-ppm")) {
-      IORequest* ioreq = new IORequest();
-      char* system = "injSpec.super"; 
-      int ppmValue =0;
-      if(!strcmp(argList.String("-ppm"), "BOOSTER_USER_FOR_NSRL")) {
-          int id = ioreq->addEntry(system, "boosterPpmUserForNsrlM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "BOOSTER_USER_FOR_AGS")) {
-          int id = ioreq->addEntry(system, "boosterPpmUserForAgsM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "TANDEM_USER_FOR_NSRL")) {
-          int id = ioreq->addEntry(system, "tandemPpmUserForNsrlM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "TANDEM_USER_FOR_AGS")) {
-          int id = ioreq->addEntry(system,"tandemPpmUserForAgsM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "LINAC_USER_FOR_NSRL")) {
-          int id = ioreq->addEntry(system,"linacPpmUserForNsrlM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "LINAC_USER_FOR_AGS")) {
-          int id = ioreq->addEntry(system,"linacPpmUserForAgsM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "EBIS_USER_FOR_NSRL")) {
-          int id = ioreq->addEntry(system,"ebisPpmUserForNsrlM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "EBIS_USER_FOR_AGS")) {
-          int id = ioreq->addEntry(system,"ebisPpmUserForAgsM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "EBIS_USER_FOR_BOOSTER")) {
-          int id = ioreq->addEntry(system,"ebisPpmUserForBoosterM");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else if(!strcmp(argList.String("-ppm"), "AGS_USER_FOR_RHIC")) {
-          int id = ioreq->addEntry(system, "agsPpmUserForRhicS");
-          IOData d;
-          int result = ioreq->get(id, &d);
-          ppmValue = atoi(d.stringVal());
-      } else {
-          ppmValue = atoi(argList.String("-ppm"));
-      }   
-      set_ppm_user(ppmValue);
-      ioreq = NULL;
-  }
+  if (argList.IsPresent("-ppm"))
+      set_ppm_user(ResolvePpmUser(argList.String("-ppm")));
 
   // create the mainWindow
   if (mainWindow == NULL) {
@@ -420,7 +441,7 @@ int main(int argc, char *argv[])
       }
     // dump snap shot of the AGS page to the elog and exit
     if (singleDeviceListOnly)
-      dumpElogAndExitTimerId = application->EnableTimerEvent(1000);
+      dumpElogAndExitTimerId = GlobalTimerWheel()->Arm(mainWindow, 1000);
     else
       singlePetWin->ElogDumpAndExit();
   } else if ((argList.IsPresent("-dumpToElog") || argList.IsPresent("-dumpToDefaultElog")) &&
@@ -440,7 +461,7 @@ int main(int argc, char *argv[])
       printTool->SetElogAttachToTitle(argList.String("-elogAttachToTitle") );
     // dump snap shot of the page to the elog and exit
     if (singleDeviceListOnly)
-      dumpElogAndExitTimerId = application->EnableTimerEvent(1000);
+      dumpElogAndExitTimerId = GlobalTimerWheel()->Arm(mainWindow, 1000);
     else
       singlePetWin->ElogDumpAndExit();
   }
@@ -453,6 +474,10 @@ int main(int argc, char *argv[])
           singlePetWin->SetLocalPetWindowCreating(singleWindowMode);
   }
 
+  // time the main window once it is up
+  if (argList.IsPresent("-scaleBench") && mainWindow != NULL)
+    scaleBenchTimerId = GlobalTimerWheel()->Arm(mainWindow, 1000);
+
   // loop forever handling user events
   application->HandleEvents();
 }
@@ -460,14 +485,13 @@ int main(int argc, char *argv[])
 ///////////////////////// PetEventReceiver class ///////////////////////
 PetEventReceiver::PetEventReceiver()
 {
-   for (int i=0; i<50; i++)
-      cldWins[i] = NULL;
 }
 
 PetEventReceiver::~PetEventReceiver()
 {
-   for (int i=0; i<50; i++)
-      delete cldWins[i];
+   SSCldLauncher::CancelAll(this);
+   for (list<SSCldWindow*>::iterator it = cldWins.begin(); it != cldWins.end(); ++it)
+      delete *it;
 }
 
 void PetEventReceiver::HandleEvent(const UIObject* object, UIEvent event)
@@ -478,56 +502,27 @@ void PetEventReceiver::HandleEvent(const UIObject* object, UIEvent event)
      // this is essentially ShowCldEditor() but cld window pointers are stored
      // here
      PetPage* ppage = singlePetWin->GetPetPage();
-     const char* devname = ppage->CellGetAdo();
-     SSCldWindow* win = new SSCldWindow(singlePetWin, "sscldWindow", devname,
-                                        ppage->GetPPMUser());
-     if (win->SuccessfullyCreated() == UIFalse || win->DataToCollect() == UIFalse){
-        UILabelPopup popup(singlePetWin, "cldProbPopup", "NULL", "OK");
-        if (win->SuccessfullyCreated() == UIFalse)
-        {
-           int failure=win->ReasonNoCreate();
-           if (failure == DEVICE_BAD_NAME)
-              popup.SetLabel("CLD ", devname, " does not exist.\nCLD window creation aborted.");
-           else if (failure == DC_GET_TIMEOUT)
-              popup.SetLabel("CLD ", devname, " not reporting.\nCLD window creation aborted.");
-           else if (failure == DEVICE_BAD_REPORTFORMAT)
-              popup.SetLabel("CLD ", devname, " - bad report format.\nCLD window creation aborted.");
-           else if (failure == DEVICE_NODATA)
-              popup.SetLabel("CLD ", devname, " - no report received.\nCLD window creation aborted.");
-           else if (failure == DEVICE_UNPACKERROR || failure == DEVICE_BAD_REPORTFORMAT || failure == DEVICE_NOBUFFERSPACE)
-              popup.SetLabel("CLD ", devname, " - report format error.\nCLD window creation aborted.");
-           else
-              popup.SetLabel("CLD ", devname, " - unknown error.\nCLD window creation aborted.");
-        }
-        else
-           popup.SetLabel("CLD ", devname, " - no data to collect.\nCLD window creation aborted.");
-        delete win;
-        popup.RingBell();
-        popup.Wait();
-        return;
-     }
-     win->EnableEvent(UIWindowMenuClose);
-     win->AddEventReceiver(&petEventReceiver);
-     win->Show();
-     // store the window pointer
-     for (int i=0; i<50; i++){
-        if (cldWins[i] == NULL) {
-           cldWins[i] = win;
-           break;
-        }
-     }
-
+     SSCldLauncher::Launch(singlePetWin, ppage->CellGetAdo(), ppage->GetPPMUser(), this);
   } else if (event == UIWindowMenuClose){
-     for (int i=0; i<50; i++){
-        if (cldWins[i] == object){
-           cldWins[i]->DeleteThis();
-           cldWins[i] = NULL;
+     for (list<SSCldWindow*>::iterator it = cldWins.begin(); it != cldWins.end(); ++it){
+        if (*it == object){
+           (*it)->DeleteThis();
+           cldWins.erase(it);
            break;
         }
      }
   }
 }
 
+void PetEventReceiver::CldWindowCreated(SSCldWindow* win)
+{
+  win->EnableEvent(UIWindowMenuClose);
+  win->AddEventReceiver(this);
+  win->Show();
+  // store the window pointer
+  cldWins.push_back(win);
+}
+
 ////////////// SSMainWindow Class Methods ////////////////////////
 SSMainWindow::SSMainWindow(const UIObject* parent, const char* name, const char* title)
   : UIMainWindow(parent, name, title, UIFalse)
@@ -543,7 +538,11 @@ SSMainWindow::SSMainWindow(const UIObject* parent, const char* name, const char*
   _historyPopup = NULL;
   _recentPopup = NULL;
   _totalFlashTimerId = 0L;
+  _perfViewer = NULL;
+  _perfTimerId = 0L;
   _selectionHistory = new SelectionHistory("pet");
+  _messagePending = false;
+  GlobalFrameScheduler()->Register(this);
 
   // resources
   static const char* defaults[] = {
@@ -690,9 +689,17 @@ void SSMainWindow::InitArchiveLib()
 
 void SSMainWindow::SetMessage(const char* message)
 {
+  // a message set directly is newer than any which is waiting for its frame
+  _messagePending = false;
   messageArea->SetMessage(message);
 }
 
+void SSMainWindow::FlushFrame(const std::vector<unsigned long>& dirtyCells)
+{
+  if (_messagePending)
+    SetMessage(_pendingMessage.c_str());
+}
+
 void SSMainWindow::SetPPMLabel()
 {
   // get the ppm user number used by this process
@@ -856,6 +863,13 @@ void SSMainWindow::HandleEvent(const UIObject* object, UIEvent event)
   else if(object == viewer && event == UIWindowMenuClose)
     viewer->Hide();
 
+  // user closing the Performance Monitor - it is no longer refreshed
+  else if(object == _perfViewer && event == UIWindowMenuClose) {
+    _perfViewer->Hide();
+    GlobalTimerWheel()->Cancel(_perfTimerId);
+    _perfTimerId = 0L;
+  }
+
   // user wants to load a pet page via one of the search popups
   else if( (object == _searchPopup || object == _modifiedPopup || object == _checkedOutPopup) && event == UISelect)
   {
@@ -1529,15 +1543,18 @@ void SSMainWindow::HandleEvent(const UIObject* object, UIEvent event)
       else if(!strcmp(data->namesSelected[1], "PPM User Monitor")) {
         SO_PpmUserMonitor();
       }
+      else if(!strcmp(data->namesSelected[1], "Performance Monitor")) {
+        SO_Performance_Monitor();
+      }
 //       else if(!strcmp(data->namesSelected[1], "Reload DDF...")) {
 //         SO_Load_DDF();
 //       }
       else if(!strcmp(data->namesSelected[1], "Flash Pages")) {
         if(_totalFlashTimerId > 0L) {
-          application->DisableTimerEvent(_totalFlashTimerId);
+          GlobalTimerWheel()->Cancel(_totalFlashTimerId);
         }
         // start the timer to flash the windows for four seconds
-        _totalFlashTimerId = application->EnableTimerEvent(4000);
+        _totalFlashTimerId = GlobalTimerWheel()->Arm(this, 4000);
         SO_Flash_Pages();
       }
     }
@@ -1548,31 +1565,53 @@ void SSMainWindow::HandleEvent(const UIObject* object, UIEvent event)
       // they have their own message areas!
       // check to see if sent from one of the device pages
       const char* className = object->ClassName();
+      // a burst of messages is shown once per frame, the last one wins
       if( strcmp( className, "SSPageWindow") && strcmp( className, "SSCldWindow")
           && strcmp( className, "PetWindow") && strcmp( className, "PetPage"))
-        SetMessage(object->GetMessage());
-    }
-  else if (object == application && event == UITimer)
-    {
-      if (application->GetTimerId() == dumpElogAndExitTimerId){
-        SSPageWindow* ldWin = (SSPageWindow*) GetWindow(1);
-        if (ldWin){
-          ldWin->PrintDump();
-          exit(0);
-        } else
-          SetMessage("Unable to find window for elog dump");
-      }
-      else if (application->GetTimerId() == _totalFlashTimerId) {
-        // stop the flashing of the pages
-        SO_Flash_Pages(false);
-        _totalFlashTimerId = 0L;
-      }
+        {
+          const char* message = object->GetMessage();
+          _pendingMessage = (message != NULL) ? message : "";
+          _messagePending = true;
+          GlobalFrameScheduler()->MarkDirty(this, 0);
+        }
     }
   // otherwise, pass event to base class
   else
     UIMainWindow::HandleEvent(object, event);
 }
 
+void SSMainWindow::TimerExpired(unsigned long timerId)
+{
+  if (timerId == dumpElogAndExitTimerId) {
+    SSPageWindow* ldWin = (SSPageWindow*) GetWindow(1);
+    if (ldWin){
+      ldWin->PrintDump();
+      exit(0);
+    } else
+      SetMessage("Unable to find window for elog dump");
+  }
+  else if (timerId == scaleBenchTimerId) {
+    FILE* out = stdout;
+    if (strlen(argList.String("-scaleBenchOut")))
+      out = fopen(argList.String("-scaleBenchOut"), "w");
+    if (out == NULL) {
+      fprintf(stderr, "Cannot write %s\n", argList.String("-scaleBenchOut"));
+      exit(1);
+    }
+    ScaleBench(argList.Value("-scaleBench"), out);
+    fclose(out);
+    exit(0);
+  }
+  else if (timerId == _perfTimerId) {
+    LoadPerfReport();
+  }
+  else if (timerId == _totalFlashTimerId) {
+    // stop the flashing of the pages
+    SO_Flash_Pages(false);
+    _totalFlashTimerId = 0L;
+  }
+}
+
 SSPageWindow* SSMainWindow::CreateLdWindow()
 {
   SSPageWindow* ldWin;
@@ -2337,9 +2376,9 @@ int SSMainWindow::ConfirmQuit()
 
   SO_Flash_Pages(false);
 
-  if (_totalFlashTimerId > 0L && application != NULL)
+  if (_totalFlashTimerId > 0L)
     {
-      application->DisableTimerEvent(_totalFlashTimerId);
+      GlobalTimerWheel()->Cancel(_totalFlashTimerId);
       _totalFlashTimerId = 0L;
     }
 
@@ -2546,6 +2585,62 @@ void SSMainWindow::SO_PpmUserMonitor()
   system("/usr/controls/bin/PpmUserMon &");
 }
 
+void SSMainWindow::SO_Performance_Monitor()
+{
+  if (_perfViewer == NULL) {
+    _perfViewer = new UIViewerWindow(this, "perfViewer");
+    _perfViewer->SetTitle("Performance Monitor");
+    _perfViewer->LockFile();	// turn off access to file system
+    _perfViewer->AddEventReceiver(this);
+  }
+  if (!LoadPerfReport()) {
+    SetMessage("Could not write the performance report");
+    return;
+  }
+  _perfViewer->Show();
+  // the report is reloaded every second while it is shown
+  if (_perfTimerId == 0L)
+    _perfTimerId = GlobalTimerWheel()->Arm(this, 1000, true);
+}
+
+// the viewer only loads files - the report goes to a file of its own, which
+// nobody else can have made or linked
+bool SSMainWindow::LoadPerfReport()
+{
+  char path[] = "/tmp/petPerfMonitor.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0)
+    return false;
+  FILE* fp = fdopen(fd, "w");
+  if (fp == NULL) {
+    close(fd);
+    unlink(path);
+    return false;
+  }
+  WritePerfReport(fp);
+  fclose(fp);
+  bool loaded = (_perfViewer->LoadFile(path) >= 0);
+  unlink(path);
+  return loaded;
+}
+
+void SSMainWindow::WritePerfReport(FILE* fp)
+{
+  fprintf(fp, "%-40s %9s %9s %9s %9s %9s %9s\n", "Server", "queued", "in flight",
+          "completed", "failed", "timeouts", "mean ms");
+  std::vector<std::string> servers;
+  GlobalServerPool()->GetServers(servers);
+  for (unsigned i=0; i<servers.size(); i++) {
+    PetServerStats stats;
+    if (!GlobalServerPool()->GetStats(servers[i].c_str(), stats))
+      continue;
+    char name[64];
+    snprintf(name, sizeof(name), "%s%s", servers[i].c_str(), stats.down ? " (down)" : "");
+    fprintf(fp, "%-40.40s %9lu %9lu %9llu %9llu %9llu %9.1f\n", name, stats.queued, stats.inFlight,
+            stats.completed, stats.failed, stats.timeouts, stats.MeanLatencyMsec());
+  }
+}
+
 static controller_record_t*  get_controller() {
 
     int i;
@@ -2685,6 +2780,9 @@ void SSMainWindow::SO_Load_DDF()
         sprintf(msg, "ddf successfully mapped.");
     }
 
+  // CLDs which could not be displayed may be fixed by the new ddf
+  GlobalCldFailureCache()->Invalidate();
+
   // now reload the ld pages
   for (int i=0; i<index; i++){
     treeTable->SetNodeSelected(nodes[i]);
@@ -2745,42 +2843,123 @@ void SSMainWindow::SO_Flash_Pages(bool flash)
   }
 }
 
+static double BenchUsec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static void BenchResult(FILE* out, long size, const char* metric, double value)
+{
+  fprintf(out, "{\"bench\":\"mainWindow\",\"size\":%ld,\"metric\":\"%s\",\"value\":%.6g,\"unit\":\"us\"}\n",
+          size, metric, value);
+  fflush(out);
+}
+
+// the device list every ScaleBench page loads - rows of labels, which
+// need no server
+#define PET_BENCH_LIST_ROWS	20
+#define PET_BENCH_LIST_TITLE	"/bench/device_list"
+
+SSPageWindow* SSMainWindow::OpenBenchPage(const char* listPath)
+{
+  SSPageWindow* win = CreateLdWindow();
+  if (win->LoadFile(listPath, PET_BENCH_LIST_TITLE, get_ppm_user()) < 0)
+    return NULL;
+  win->SetDevListPath(PET_BENCH_LIST_TITLE);
+  win->SetListString();
+  LoadPageList(win);
+  return win;
+}
+
+void SSMainWindow::ScaleBench(int maxWindows, FILE* out)
+{
+  static const int sizes[] = { 10, 25, 50, 100, 200, 300, 500, 1000 };
+  const int reps = 20;
+
+  // write the device list to a directory of its own
+  char dir[] = "/tmp/petScaleBench.XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    fprintf(stderr, "Cannot create a directory for the bench device list\n");
+    return;
+  }
+  string listPath = string(dir) + "/" + LD_DEVICE_LIST;
+  FILE* fp = fopen(listPath.c_str(), "w");
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot write %s\n", listPath.c_str());
+    rmdir(dir);
+    return;
+  }
+  fprintf(fp, "# pet -scaleBench device list\n");
+  for (int i=1; i<=PET_BENCH_LIST_ROWS; i++)
+    fprintf(fp, "\"bench row %d\", \"label\", \"label\"\n", i);
+  fclose(fp);
+
+  DeleteAllWindows();
+  for (unsigned s=0; s<sizeof(sizes)/sizeof(sizes[0]) && sizes[s] <= maxWindows; s++) {
+    long size = sizes[s];
+
+    // open and load pages up to the size - the mean time of those opened
+    long numOpened = size - GetNumWindows();
+    double start = BenchUsec();
+    bool loaded = true;
+    while (loaded && GetNumWindows() < size)
+      loaded = (OpenBenchPage(listPath.c_str()) != NULL);
+    if (!loaded) {
+      fprintf(stderr, "Cannot load %s into a page\n", listPath.c_str());
+      break;
+    }
+    BenchResult(out, size, "open", (BenchUsec() - start) / numOpened);
+
+    // a page made active, as when it is clicked
+    start = BenchUsec();
+    for (int i=0; i<reps; i++)
+      HandleEvent(GetWindow(1 + (i * 7) % size), UIWindowActive);
+    BenchResult(out, size, "activate", (BenchUsec() - start) / reps);
+
+    // looking for a page which is not open scans them all
+    start = BenchUsec();
+    for (int i=0; i<reps; i++)
+      FindWindow("/bench/none/device_list", PET_LD_WINDOW);
+    BenchResult(out, size, "find", (BenchUsec() - start) / reps);
+
+    start = BenchUsec();
+    for (int i=0; i<reps; i++)
+      LoadPageList(GetWindow(1 + i % size));
+    BenchResult(out, size, "pageList", (BenchUsec() - start) / reps);
+
+    // close the first page, which makes the list be scanned for the next
+    // visible page
+    double closing = 0.0;
+    for (int i=0; i<reps; i++) {
+      start = BenchUsec();
+      DeleteListWindow(GetWindow(1));
+      closing += BenchUsec() - start;
+      OpenBenchPage(listPath.c_str());
+    }
+    BenchResult(out, size, "close", closing / reps);
+
+    start = BenchUsec();
+    SO_Flash_Pages(true);
+    SO_Flash_Pages(false);
+    BenchResult(out, size, "flash", (BenchUsec() - start) / 2);
+  }
+  DeleteAllWindows();
+  unlink(listPath.c_str());
+  rmdir(dir);
+}
+
 void SSMainWindow::ShowCldEditor(const char* devname, int ppmuser)
 {
-  // create a new SSCldWindow
+  // create a new SSCldWindow - CldWindowCreated() is called once it is ready
   Refresh();
   SetMessage("Creating new CLD page...");
-  SetWorkingCursor();
-  SSCldWindow* win = new SSCldWindow(this, "sscldWindow", devname, ppmuser);
-  if (win->SuccessfullyCreated() == UIFalse || win->DataToCollect() == UIFalse)
-    {
-      SetStandardCursor();
-      SetMessage("");
-      UILabelPopup popup(this, "cldProbPopup", "NULL", "OK");
-      if (win->SuccessfullyCreated() == UIFalse)
-	{
-	  int failure=win->ReasonNoCreate();
-	  if (failure == DEVICE_BAD_NAME)
-	    popup.SetLabel("CLD ", devname, " does not exist.\nCLD window creation aborted.");
-	  else if (failure == DC_GET_TIMEOUT)
-	    popup.SetLabel("CLD ", devname, " not reporting.\nCLD window creation aborted.");
-	  else if (failure == DEVICE_BAD_REPORTFORMAT)
-	    popup.SetLabel("CLD ", devname, " - bad report format.\nCLD window creation aborted.");
-	  else if (failure == DEVICE_NODATA)
-	    popup.SetLabel("CLD ", devname, " - no report received.\nCLD window creation aborted.");
-	  else if (failure == DEVICE_UNPACKERROR || failure == DEVICE_BAD_REPORTFORMAT || failure == DEVICE_NOBUFFERSPACE)
-	    popup.SetLabel("CLD ", devname, " - report format error.\nCLD window creation aborted.");
-	  else
-	    popup.SetLabel("CLD ", devname, " - unknown error.\nCLD window creation aborted.");
-	}
-      else
-	popup.SetLabel("CLD ", devname, " - no data to collect.\nCLD window creation aborted.");
-      delete win;
-      popup.RingBell();
-      popup.Wait();
-      return;
-    }
+  SSCldLauncher::Launch(this, devname, ppmuser, this);
+}
 
+void SSMainWindow::CldWindowCreated(SSCldWindow* win)
+{
   // show it on the screen
   AddListWindow(win);
   win->SetListString();
@@ -2789,10 +2968,16 @@ void SSMainWindow::ShowCldEditor(const char* devname, int ppmuser)
   // update main window if device list loaded successfully
   // update the device page list
   LoadPageList(win);
-  SetStandardCursor();
   SetMessage("");
 }
 
+bool SSMainWindow::CldWindowFailed(const char* devname, const char* error)
+{
+  // the error is shown in a popup
+  SetMessage("");
+  return false;
+}
+
 void SSMainWindow::SO_CLD_Events()
 {
   // select the event line
@@ -2911,12 +3096,9 @@ SSPageWindow::~SSPageWindow()
   if(devListPath != NULL)
     free(devListPath);
   parent->RemoveEventReceiver(this);
-  if (application)
-    {
-      application->RemoveEventReceiver(this);
-      if (flashTimerId > 0L)
-        application->DisableTimerEvent(flashTimerId);
-    }
+  if (flashTimerId > 0L)
+    GlobalTimerWheel()->Cancel(flashTimerId);
+  SSCldLauncher::CancelAll(this);
 }
 
 void SSPageWindow::Initialize()
@@ -3137,30 +3319,29 @@ void SSPageWindow::HandleEvent(const UIObject* object, UIEvent event)
       else
 	AgsPageWindow::HandleEvent(object, event);
     }
-  else if(object == application && event == UITimer)
-    {
-      if (application->GetTimerId() == flashTimerId) {
-        if (page->MaxPPMUsers()>1) {
-          if (menubar->GetBackgroundColor() == ppmMenu->GetPPMColor())
-            menubar->SetBackgroundColor(ppmMenu->GetPPMFgColor());
-          else
-            ppmMenu->SetPPMUser(page->GetPPMUser());
-        } else {
-          if (menubar->GetBackgroundColor() == menubar->ConvertColor("white"))
-            ppmMenu->SetPPMUser(0);
-          else
-            menubar->SetBackgroundColor("white");
-        }
-
-        // restart the timer
-        flashTimerId = application->EnableTimerEvent(500);
-      }
-    }
   // let base class handle it
   else
     AgsPageWindow::HandleEvent(object, event);
 }
 
+void SSPageWindow::TimerExpired(unsigned long timerId)
+{
+  if (timerId != flashTimerId)
+    return;
+
+  if (page->MaxPPMUsers()>1) {
+    if (menubar->GetBackgroundColor() == ppmMenu->GetPPMColor())
+      menubar->SetBackgroundColor(ppmMenu->GetPPMFgColor());
+    else
+      ppmMenu->SetPPMUser(page->GetPPMUser());
+  } else {
+    if (menubar->GetBackgroundColor() == menubar->ConvertColor("white"))
+      ppmMenu->SetPPMUser(0);
+    else
+      menubar->SetBackgroundColor("white");
+  }
+}
+
 void SSPageWindow::SP_Duplicate()
 {
   // ask user for PPM user for the duplicate page
@@ -3230,37 +3411,14 @@ void SSPageWindow::SD_Show_CLD_Editor()
       return;
     }
 
-  // create a new SSCldWindow
+  // create a new SSCldWindow - CldWindowCreated() is called once it is ready
   SetMessage("Creating CLD editor window...");
-  SetWorkingCursor();
-  SSMainWindow* mainWin = (SSMainWindow*) GetParent();
-  SSCldWindow* newWin = new SSCldWindow(mainWin, "sscldWindow", GetDeviceName(), GetPPMUser() );
-  if (newWin->SuccessfullyCreated() == UIFalse || newWin->DataToCollect() == UIFalse)
-    {
-      SetStandardCursor();
-      RingBell();
-      if (newWin->SuccessfullyCreated() == UIFalse)
-	{
-	  int failure=newWin->ReasonNoCreate();
-	  if (failure == DEVICE_BAD_NAME)
-	    SetMessage("CLD ", GetDeviceName(), " does not exist. CLD window creation aborted.");
-	  else if (failure == DC_GET_TIMEOUT)
-	    SetMessage("CLD ", GetDeviceName(), " not reporting. CLD window creation aborted.");
-	  else if (failure == DEVICE_BAD_REPORTFORMAT)
-	    SetMessage("CLD ", GetDeviceName(), " - bad report format. CLD window creation aborted.");
-	  else if (failure == DEVICE_NODATA)
-	    SetMessage("CLD ", GetDeviceName(), " - no data in report. CLD window creation aborted.");
-	  else if (failure == DEVICE_UNPACKERROR || failure == DEVICE_BAD_REPORTFORMAT || failure == DEVICE_NOBUFFERSPACE)
-	    SetMessage("CLD ", GetDeviceName(), " - report error. CLD window creation aborted.");
-	  else
-	    SetMessage("CLD ", GetDeviceName(), " - unknown error. CLD window creation aborted.");
-	}
-      else
-	SetMessage("Cld ", GetDeviceName(), " - no data to collect. CLD window creation aborted.");
-      delete newWin;
-      return;
-    }
+  SSCldLauncher::Launch(GetParent(), GetDeviceName(), GetPPMUser(), this);
+}
 
+void SSPageWindow::CldWindowCreated(SSCldWindow* newWin)
+{
+  SSMainWindow* mainWin = (SSMainWindow*) GetParent();
   if (singleDeviceListOnly)
     newWin->SetSingleDeviceListMode();
 
@@ -3275,10 +3433,17 @@ void SSPageWindow::SD_Show_CLD_Editor()
 
   // update main window
   mainWin->LoadPageList(newWin);
-  SetStandardCursor();
   SetMessage("");
 }
 
+bool SSPageWindow::CldWindowFailed(const char* devname, const char* error)
+{
+  // report problems in the message area of the page
+  RingBell();
+  SetMessage(error, " CLD window creation aborted.");
+  return true;
+}
+
 void SSPageWindow::SetSingleDeviceListMode()
 {
   if (pulldownMenu!=NULL)
@@ -3322,14 +3487,12 @@ void SSPageWindow::Flash(bool flash)
         // already one running
         return;
       }
-    // make sure we are setup to receive events
-    application->AddEventReceiver(this);
-    flashTimerId = application->EnableTimerEvent(500);
+    flashTimerId = GlobalTimerWheel()->Arm(this, 500, true);
   } else {
     // cancel the timer and set the ppm menu back to normal
     if (flashTimerId > 0L)
       {
-        application->DisableTimerEvent(flashTimerId);
+        GlobalTimerWheel()->Cancel(flashTimerId);
       }
     flashTimerId = 0L;
     if (page->MaxPPMUsers()>1)
@@ -3426,12 +3589,8 @@ SSCldWindow::~SSCldWindow()
   if(listString != NULL)
     delete [] listString;
   parent->RemoveEventReceiver(this);
-  if (application)
-    {
-      application->RemoveEventReceiver(this);
-      if (flashTimerId > 0L)
-        application->DisableTimerEvent(flashTimerId);
-    }
+  if (flashTimerId > 0L)
+    GlobalTimerWheel()->Cancel(flashTimerId);
 }
 
 void SSCldWindow::Initialize()
@@ -3482,29 +3641,28 @@ void SSCldWindow::HandleEvent(const UIObject* object, UIEvent event)
     StopContinuousUpdate();
   else if(object == window && event == UIMap)		// now out of an icon state
     StartContinuousUpdate();
-  else if (object == application && event == UITimer)
-    {
-      if (application->GetTimerId() == flashTimerId) {
-        if (MaxPPMUsers()>1) {
-          if (menubar->GetBackgroundColor() == ppmMenu->GetPPMColor())
-            menubar->SetBackgroundColor(ppmMenu->GetPPMFgColor());
-          else
-            ppmMenu->SetPPMUser(GetCldPPM());
-        } else {
-          if (menubar->GetBackgroundColor() == menubar->ConvertColor("white"))
-            ppmMenu->SetPPMUser(0);
-          else
-            menubar->SetBackgroundColor("white");
-        }
-
-        // restart the timer
-        flashTimerId = application->EnableTimerEvent(500);
-      }
-    }
   else
     UICldObjectWindow::HandleEvent(object, event);
 }
 
+void SSCldWindow::TimerExpired(unsigned long timerId)
+{
+  if (timerId != flashTimerId)
+    return;
+
+  if (MaxPPMUsers()>1) {
+    if (menubar->GetBackgroundColor() == ppmMenu->GetPPMColor())
+      menubar->SetBackgroundColor(ppmMenu->GetPPMFgColor());
+    else
+      ppmMenu->SetPPMUser(GetCldPPM());
+  } else {
+    if (menubar->GetBackgroundColor() == menubar->ConvertColor("white"))
+      ppmMenu->SetPPMUser(0);
+    else
+      menubar->SetBackgroundColor("white");
+  }
+}
+
 void SSCldWindow::SetSingleDeviceListMode()
 {
   if (pulldownMenu!=NULL)
@@ -3540,14 +3698,12 @@ void SSCldWindow::Flash(bool flash)
         // already one running
         return;
       }
-    // make sure we are setup to receive events
-    application->AddEventReceiver(this);
-    flashTimerId = application->EnableTimerEvent(500);
+    flashTimerId = GlobalTimerWheel()->Arm(this, 500, true);
   } else {
     // cancel the timer and set the ppm menu back to normal
     if (flashTimerId > 0L)
       {
-        application->DisableTimerEvent(flashTimerId);
+        GlobalTimerWheel()->Cancel(flashTimerId);
       }
     flashTimerId = 0L;
     if (MaxPPMUsers()>1)
@@ -3557,6 +3713,186 @@ void SSCldWindow::Flash(bool flash)
   }
 }
 
+/////////////////// SSCldLauncher Class ////////////////////////////////////
+list<SSCldLauncher*> SSCldLauncher::_launchers;
+
+// sent to a CLD before its window is built - the window is only built if
+// the CLD answers it with its report
+#define PET_CLD_REPORT_MESSAGE	"get report"
+
+void SSCldLauncher::Launch(const UIObject* parent, const char* devname, int ppmuser, SSCldClient* client)
+{
+  SSCldLauncher* launcher = new SSCldLauncher(parent, devname, ppmuser, client);
+  _launchers.push_back(launcher);
+  launcher->Start();
+}
+
+void SSCldLauncher::CancelAll(SSCldClient* client)
+{
+  list<SSCldLauncher*> launchers(_launchers);
+  for (list<SSCldLauncher*>::iterator it = launchers.begin(); it != launchers.end(); ++it)
+    if ((*it)->_client == client) {
+      (*it)->_client = NULL;
+      // one which is in the middle of its work finishes by itself
+      if (!(*it)->_busy)
+        (*it)->Finish();
+    }
+}
+
+SSCldLauncher::SSCldLauncher(const UIObject* parent, const char* devname, int ppmuser, SSCldClient* client)
+{
+  _parent = parent;
+  _devname = devname;
+  _ppmuser = ppmuser;
+  _client = client;
+  _requestId = 0L;
+  _timerId = 0L;
+  _failure = 0;
+  _dataToCollect = true;
+  _busy = false;
+
+  // show the placeholder right away
+  _placeholder = new UILabelPopup(parent, "cldPlaceholder", NULL, "OK");
+  _placeholder->SetLabel("Collecting report from CLD ", devname, "...");
+  _placeholder->Show();
+}
+
+SSCldLauncher::~SSCldLauncher()
+{
+  if (_timerId > 0L)
+    GlobalTimerWheel()->Cancel(_timerId);
+  if (_requestId > 0L)
+    GlobalServerPool()->CancelOwner(this);
+  delete _placeholder;
+}
+
+void SSCldLauncher::Start()
+{
+  // a CLD which could not be displayed a moment ago fails right away instead
+  // of repeating the database lookups and the wait for its report
+  const PetCldFailure* failure = GlobalCldFailureCache()->Find(_devname.c_str());
+  if (failure != NULL)
+    {
+      _failure = failure->failure;
+      _dataToCollect = (failure->failure != 0);
+      _timerId = GlobalTimerWheel()->Arm(this, 0);
+      return;
+    }
+
+  cdevData data;
+  unsigned long requestId = GlobalServerPool()->Submit(NULL, _devname.c_str(), PET_CLD_REPORT_MESSAGE,
+                                                       data, this, this, true);
+  // unless it was answered before Submit() returned
+  if (_timerId == 0L)
+    _requestId = requestId;
+}
+
+void SSCldLauncher::RequestDone(unsigned long requestId, int status, cdevData& result)
+{
+  _requestId = 0L;
+  // an error reply fails the creation like a missing report would
+  if (status == CDEV_TIMEOUT || status == PET_SERVER_DOWN)
+    _failure = DC_GET_TIMEOUT;
+  else if (status != CDEV_SUCCESS)
+    _failure = DEVICE_NODATA;
+  // carry on from the event loop, not from inside the server pool
+  _timerId = GlobalTimerWheel()->Arm(this, 0);
+}
+
+void SSCldLauncher::TimerExpired(unsigned long timerId)
+{
+  if (timerId != _timerId)
+    return;
+  _timerId = 0L;
+
+  _busy = true;
+  if (_failure != 0 || !_dataToCollect)
+    Fail(FailureText(_devname.c_str(), _failure, _dataToCollect));
+  else
+    BuildWindow();
+  _busy = false;
+  Finish();
+}
+
+void SSCldLauncher::BuildWindow()
+{
+  // genCldLib has no way to split the DDF lookups and the report collection
+  // from building the widgets, so the window is still built here on the UI
+  // thread and collects the report again - the CLD has just answered, but one
+  // which stops reporting in between holds the UI for up to DC_GET_TIMEOUT
+  // until the collection moves out of the constructor
+  _placeholder->SetWorkingCursor();
+  SSCldWindow* win = new SSCldWindow(_parent, "sscldWindow", _devname.c_str(), _ppmuser);
+  _placeholder->SetStandardCursor();
+
+  // remember a failure for the next window on this CLD
+  int failure = (win->SuccessfullyCreated() == UIFalse) ? win->ReasonNoCreate() : 0;
+  if (failure != 0)
+    GlobalCldFailureCache()->Failed(_devname.c_str(), failure);
+  else if (win->DataToCollect() == UIFalse)
+    GlobalCldFailureCache()->NoDataToCollect(_devname.c_str());
+  else
+    GlobalCldFailureCache()->Remove(_devname.c_str());
+
+  if (win->SuccessfullyCreated() == UIFalse || win->DataToCollect() == UIFalse)
+    {
+      bool dataToCollect = (failure != 0 || win->DataToCollect() == UITrue);
+      delete win;
+      Fail(FailureText(_devname.c_str(), failure, dataToCollect));
+      return;
+    }
+
+  _placeholder->Hide();
+  if (_client != NULL)
+    _client->CldWindowCreated(win);
+  else
+    delete win;
+}
+
+void SSCldLauncher::Fail(const string& error)
+{
+  _placeholder->Hide();
+  if (_client == NULL || _client->CldWindowFailed(_devname.c_str(), error.c_str()))
+    return;
+
+  // the client did not report it - show the error until the user dismisses it
+  UILabelPopup popup(_parent, "cldProbPopup", NULL, "OK");
+  string text = error + "\nCLD window creation aborted.";
+  popup.SetLabel(text.c_str());
+  popup.RingBell();
+  popup.Wait();
+}
+
+void SSCldLauncher::Finish()
+{
+  _launchers.remove(this);
+  delete this;
+}
+
+string SSCldLauncher::FailureText(const char* devname, int failure, bool dataToCollect)
+{
+  string text = "CLD ";
+  text += devname;
+  if (failure != 0)
+    {
+      if (failure == DEVICE_BAD_NAME)
+        text += " does not exist.";
+      else if (failure == DC_GET_TIMEOUT)
+        text += " not reporting.";
+      else if (failure == DEVICE_BAD_REPORTFORMAT)
+        text += " - bad report format.";
+      else if (failure == DEVICE_NODATA)
+        text += " - no report received.";
+      else if (failure == DEVICE_UNPACKERROR || failure == DEVICE_NOBUFFERSPACE)
+        text += " - report format error.";
+      else
+        text += " - unknown error.";
+    }
+  else if (!dataToCollect)
+    text += " - no data to collect.";
+  return text;
+}
+
 /////// C++ Helper Routines ////////////////////
 const char* GetLeafName(const char* deviceListPath)
 {
@@ -12,15 +12,36 @@
 #include <UI/UIHelp.hxx>                // for UIHelpMenu class
 #include <UIUtils/UIHistoryPopup.hxx>   // for UIHistoryPopup class
 #include <dbtools/SelectionHistory.hxx>
+#include <list>
+#include <string>
+#include "PetTimerWheel.hxx"
+#include "PetServerPool.hxx"
+#include "PetFrameScheduler.hxx"
 
 enum PET_WINDOW_TYPE {PET_LD_WINDOW, PET_CLD_WINDOW, PET_ADO_WINDOW, PET_HYBRID_WINDOW, PET_UNKNOWN_WINDOW};
 
 class SSPageWindow;
+class SSCldWindow;
 class MenuTree;
 class UICreateDeviceList;
 class PetScrollingEnumList;
 
-class SSMainWindow : public UIMainWindow
+// receives the result of an asynchronous CLD window creation (see SSCldLauncher)
+class SSCldClient
+{
+public:
+  virtual ~SSCldClient() {}
+
+  // the CLD window was created and has data to collect
+  virtual void CldWindowCreated(SSCldWindow* win) = 0;
+
+  // the CLD window could not be created - return true if the error has been
+  // reported, false to have it displayed in the placeholder popup
+  virtual bool CldWindowFailed(const char* devname, const char* error) { return false; }
+};
+
+class SSMainWindow : public UIMainWindow, public PetTimerClient, public SSCldClient,
+                     public PetFrameClient
 {
 public:
   SSMainWindow(const UIObject* parent, const char* name, const char* title = NULL);
@@ -28,9 +49,20 @@ public:
   // handle UI events
   void HandleEvent(const UIObject* object, UIEvent event);
 
+  // handle the elog dump, scale bench, stop flashing and performance monitor
+  // timers
+  void TimerExpired(unsigned long timerId);
+
+  // add a newly created CLD window to the page list
+  void CldWindowCreated(SSCldWindow* win);
+  bool CldWindowFailed(const char* devname, const char* error);
+
   // set the message in the message area
   void SetMessage(const char* message);
 
+  // show the last message of a frame
+  void FlushFrame(const std::vector<unsigned long>& dirtyCells);
+
   // redisplay the machine tree based on a new selection
   void LoadTable(const UIWindow* window);
   void LoadTable(const StdNode* node);
@@ -73,6 +105,12 @@ public:
   // initialize the archive lib tools
   void InitArchiveLib();
 
+  // time the page list bookkeeping with growing numbers of pages open, up to
+  // maxWindows - each page loads a small device list of labels, so no
+  // servers are needed, but a display is (Xvfb will do)
+  // one JSON line per result, as petBench writes them
+  void ScaleBench(int maxWindows, FILE* out);
+
 protected:
   UIMenubar*			menubar;
   UIPulldownMenu*	       	pulldownMenu;
@@ -97,6 +135,13 @@ protected:
   UIRecentHistoryPopup*         _recentPopup;
   unsigned long                 _totalFlashTimerId; // to timeout flashing after 4 seconds.
   SelectionHistory*             _selectionHistory;
+  std::string                   _pendingMessage;  // UIMessage waiting for its frame
+  bool                          _messagePending;
+  UIViewerWindow*               _perfViewer;	// the Performance Monitor
+  unsigned long                 _perfTimerId;	// refreshes it every second
+
+  // create a page and load a ScaleBench device list into it
+  SSPageWindow* OpenBenchPage(const char* listPath);
 
   // set the window position for a newly created window
   void SetWindowPos(UIWindow* newWin, UIWindow* currWin = NULL);
@@ -140,6 +185,9 @@ protected:
   void SO_CLD_Events();
   void SO_Load_DDF();
   void SO_Flash_Pages(bool flash = true);
+  void SO_Performance_Monitor();
+  bool LoadPerfReport();
+  void WritePerfReport(FILE* fp);
   void Exit();
 
   // helper routines
@@ -154,7 +202,7 @@ protected:
 };
 
 /////////////////////////////////////////////////////////////////////
-class SSPageWindow : public AgsPageWindow
+class SSPageWindow : public AgsPageWindow, public PetTimerClient, public SSCldClient
 {
 public:
   SSPageWindow(const UIObject* parent, const char* name,
@@ -200,6 +248,13 @@ public:
   // flash the ppm menu when quitting pet program or at user request
   void Flash(bool flash);
 
+  // toggle the ppm menu color while flashing
+  void TimerExpired(unsigned long timerId);
+
+  // hand a CLD editor window created for this page to the main window
+  void CldWindowCreated(SSCldWindow* win);
+  bool CldWindowFailed(const char* devname, const char* error);
+
 protected:
   char*		listString;	// string to display in device page list
   const StdNode*	pageNode;	// the node in the machine tree
@@ -246,7 +301,7 @@ private:
 const char* GetLeafName(const char* deviceListPath);
 
 /////////////////////////////////////////////////////////////////////
-class SSCldWindow : public UICldObjectWindow
+class SSCldWindow : public UICldObjectWindow, public PetTimerClient
 {
 public:
   //after creating a UICldObjectWindow, user should always check for successful creation
@@ -271,6 +326,9 @@ public:
   // flash the ppm menu when quitting pet program or at user request
   void Flash(bool flash);
 
+  // toggle the ppm menu color while flashing
+  void TimerExpired(unsigned long timerId);
+
 protected:
   char*		listString;	// string to display in device page list
   unsigned long flashTimerId;   // to continuously flash every 500 msec.
@@ -281,8 +339,68 @@ private:
 };
 
 
+// SSCldLauncher creates an SSCldWindow without holding up its caller.  A
+// placeholder popup is shown right away and a non-blocking get is sent to the
+// CLD through the server pool.  The window, whose constructor does the DDF
+// lookups and collects the report, is only built once the CLD has answered
+// with its report, so a CLD which is not reporting fails without the UI
+// waiting for it.  The client is then handed the window, or the error text
+// (bad name, not reporting, bad format, ...).  A launcher deletes itself when
+// it is done.
+//
+// This is a first step: the window is still built on the UI thread, and a
+// CLD which stops reporting right after the get holds the UI as before.
+class SSCldLauncher : public PetTimerClient, public PetServerRequester
+{
+public:
+  // start creating a CLD window for devname
+  static void Launch(const UIObject* parent, const char* devname, int ppmuser, SSCldClient* client);
+
+  // forget the pending creations of a client which is going away
+  static void CancelAll(SSCldClient* client);
+
+  // the reason a CLD window could not be created, as a sentence
+  // failure is the ReasonNoCreate() of the window, 0 if it was created
+  static std::string FailureText(const char* devname, int failure, bool dataToCollect);
+
+  // the answer of the CLD
+  void RequestDone(unsigned long requestId, int status, cdevData& result);
+
+  // create the window (or report the failure) from the event loop
+  void TimerExpired(unsigned long timerId);
+
+private:
+  SSCldLauncher(const UIObject* parent, const char* devname, int ppmuser, SSCldClient* client);
+  ~SSCldLauncher();
+
+  // send the get to the CLD, or fail a CLD known to be unusable
+  void Start();
+
+  // build the window and hand it to the client
+  void BuildWindow();
+
+  // report an error to the client or in a popup
+  void Fail(const std::string& error);
+
+  // remove the launcher from the list and delete it
+  void Finish();
+
+  static std::list<SSCldLauncher*> _launchers;
+
+  const UIObject* _parent;
+  std::string     _devname;
+  int             _ppmuser;
+  SSCldClient*    _client;
+  UILabelPopup*   _placeholder;
+  unsigned long   _requestId;	// the get to the CLD, 0 once answered
+  unsigned long   _timerId;
+  int             _failure;	// known before the window is built
+  bool            _dataToCollect;
+  bool            _busy;	// creating the window or showing an error
+};
+
 /// class used to close single page window.
-class PetEventReceiver : public UIEventReceiver
+class PetEventReceiver : public UIEventReceiver, public SSCldClient
 {
 public:
   PetEventReceiver();
@@ -291,9 +409,12 @@ public:
 
   /// override this to handle window close events properly
   void HandleEvent(const UIObject* object, UIEvent event);
+
+  /// show and remember a cld editor window created in single window mode
+  void CldWindowCreated(SSCldWindow* win);
 protected:
   /// store pointers to cld editor windows when in single window mode
-  SSCldWindow* cldWins[50];
+  std::list<SSCldWindow*> cldWins;
 };
 
 // C++ helper functions
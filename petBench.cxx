@@ -0,0 +1,203 @@
+// petBench - benchmarks of the UI independent parts pet runs: the CLD
+// failure cache, the timer wheel, the frame scheduler and the server pool.
+// The results are written one per line as JSON, in a fixed order and with
+// fixed names, so that the output of two releases can be compared line by
+// line.
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cdevErrCode.h>
+#include <agsPage/genCldLib.hxx>		// for the DEVICE_* failure codes
+#include "PetCldFailureCache.hxx"
+#include "PetTimerWheel.hxx"
+#include "PetFrameScheduler.hxx"
+#include "PetServerPool.hxx"
+
+static FILE* out = stdout;
+
+static void Result(const char* bench, long size, const char* metric, double value, const char* unit)
+{
+  fprintf(out, "{\"bench\":\"%s\",\"size\":%ld,\"metric\":\"%s\",\"value\":%.6g,\"unit\":\"%s\"}\n",
+          bench, size, metric, value, unit);
+  fflush(out);
+}
+
+static double NowMsec()
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
+}
+
+// the name of CLD i - systems of subsystems of CLDs
+static std::string CldName(long i)
+{
+  char name[64];
+  sprintf(name, "sys%ld.sub%ld.cld%ld", i / 10000, i / 100 % 100, i);
+  return name;
+}
+
+// numClds failed CLDs are remembered and looked up, as each CLD window
+// creation does
+static void BenchCldFailureCache(long numClds)
+{
+  std::vector<std::string> names(numClds);
+  for (long i=0; i<numClds; i++)
+    names[i] = CldName(i);
+
+  PetCldFailureCache cache;
+  double start = NowMsec();
+  for (long i=0; i<numClds; i++)
+    cache.Failed(names[i].c_str(), DEVICE_BAD_NAME);
+  Result("cldFailureCache", numClds, "insert", (NowMsec() - start) * 1e6 / numClds, "ns/cld");
+
+  start = NowMsec();
+  long found = 0;
+  for (long i=0; i<numClds; i++)
+    found += (cache.Find(names[(i * 7919) % numClds].c_str()) != NULL);
+  Result("cldFailureCache", numClds, "lookup", (NowMsec() - start) * 1e6 / numClds, "ns/cld");
+  if (found != numClds)
+    fprintf(stderr, "cldFailureCache: %ld of %ld failures found\n", found, numClds);
+}
+
+// numTimers timers like pet's flash, launcher and timeout timers are armed,
+// half of them cancelled, and the rest expire
+class BenchTimerClient : public PetTimerClient
+{
+public:
+  BenchTimerClient() : numExpired(0) {}
+  void TimerExpired(unsigned long) { numExpired++; }
+  long numExpired;
+};
+
+static void BenchTimerWheel(long numTimers)
+{
+  PetTimerWheel wheel;
+  BenchTimerClient client;
+  std::vector<unsigned long> ids(numTimers);
+  double start = NowMsec();
+  for (long i=0; i<numTimers; i++)
+    ids[i] = wheel.Arm(&client, (i * 7919) % 10000);
+  Result("timerWheel", numTimers, "arm", (NowMsec() - start) * 1e6 / numTimers, "ns/timer");
+
+  start = NowMsec();
+  for (long i=0; i<numTimers; i += 2)
+    wheel.Cancel(ids[i]);
+  Result("timerWheel", numTimers, "cancel", (NowMsec() - start) * 1e6 / ((numTimers + 1) / 2), "ns/timer");
+
+  start = NowMsec();
+  wheel.Advance(wheel.Now() + 20000);
+  Result("timerWheel", numTimers, "expire", (NowMsec() - start) * 1e6 / std::max(client.numExpired, 1L), "ns/timer");
+}
+
+// the main window's message area - every message marks its row, and the
+// dirty rows are repainted once per frame
+class BenchFrameClient : public PetFrameClient
+{
+public:
+  BenchFrameClient() : numPainted(0) {}
+  void FlushFrame(const std::vector<unsigned long>& dirtyCells) { numPainted += dirtyCells.size(); }
+  unsigned long long numPainted;
+};
+
+static void BenchFrames(long numCells)
+{
+  PetTimerWheel wheel;
+  PetFrameScheduler scheduler(&wheel);
+  BenchFrameClient client;
+  scheduler.Register(&client);
+  long numFrames = 1000;
+  long marksPerFrame = 2 * numCells;
+  double start = NowMsec();
+  for (long frame=0; frame<numFrames; frame++) {
+    for (long i=0; i<marksPerFrame; i++)
+      scheduler.MarkDirty(&client, (frame * 31 + i * 7919) % numCells);
+    wheel.Advance(wheel.Now() + PET_DEFAULT_FRAME_MSEC);
+  }
+  double msec = NowMsec() - start;
+  Result("frames", numCells, "mark", msec * 1e6 / scheduler.NumMarks(), "ns/mark");
+  Result("frames", numCells, "coalesced", (double) scheduler.NumMarks() / std::max(client.numPainted, 1ULL), "marks/paint");
+  scheduler.Unregister(&client);
+}
+
+// the server pool with servers which answer at once - what queueing,
+// windowing and completing a request costs pet, e.g. for CLD reports
+class BenchPool : public PetServerPool, public PetServerRequester
+{
+public:
+  BenchPool(PetTimerWheel* wheel) : PetServerPool(wheel), numDone(0) {}
+
+  // answer everything sent so far - returns how many
+  long Answer()
+  {
+    std::vector<Request*> sent;
+    sent.swap(_sent);
+    cdevData result;
+    for (unsigned i=0; i<sent.size(); i++)
+      Complete(sent[i], CDEV_SUCCESS, result);
+    return sent.size();
+  }
+
+  void RequestDone(unsigned long, int, cdevData&) { numDone++; }
+  long numDone;
+
+protected:
+  int Send(Request* request) { _sent.push_back(request); return 0; }
+
+private:
+  std::vector<Request*> _sent;
+};
+
+static void BenchServerPool(long numRequests)
+{
+  PetTimerWheel wheel;
+  BenchPool pool(&wheel);
+  cdevData data;
+  char server[32], device[32];
+  double start = NowMsec();
+  for (long i=0; i<numRequests; i++) {
+    sprintf(server, "server%ld", i % 20);
+    sprintf(device, "sys.cld%ld", i);
+    // each window owns a share of the requests
+    pool.Submit(server, device, "get report", data, &pool, (const void*) (i % 50 + 1));
+  }
+  double submitted = NowMsec();
+  long rounds = 0;
+  while (pool.Answer() > 0)
+    rounds++;
+  double end = NowMsec();
+  Result("serverPool", numRequests, "submit", (submitted - start) * 1000.0 / numRequests, "us/request");
+  Result("serverPool", numRequests, "complete", (end - submitted) * 1000.0 / std::max(pool.numDone, 1L), "us/request");
+  Result("serverPool", numRequests, "rounds", rounds, "windows");
+}
+
+int main(int argc, char** argv)
+{
+  for (int i=1; i+1<argc; i += 2) {
+    if (!strcmp(argv[i], "-out")) {
+      out = fopen(argv[i+1], "w");
+      if (out == NULL) {
+        fprintf(stderr, "petBench: cannot write %s\n", argv[i+1]);
+        return 1;
+      }
+    }
+    else {
+      fprintf(stderr, "usage: petBench [-out file]\n");
+      return 1;
+    }
+  }
+
+  BenchCldFailureCache(10000);
+  BenchCldFailureCache(100000);
+  BenchTimerWheel(10000);
+  BenchTimerWheel(100000);
+  BenchFrames(10);
+  BenchFrames(100);
+  BenchFrames(1000);
+  BenchServerPool(1000);
+  BenchServerPool(10000);
+  return 0;
+}